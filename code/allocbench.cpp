@@ -0,0 +1,53 @@
+// Allocation count of a simulation, build with make allocbench and run ./allocbench [max-allocations-per-event] [flags]
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "driver.h"
+using namespace std;
+
+// Every allocation of the process goes through these, so the count covers the containers of the standard library too
+static atomic<long long> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* pointer = malloc(size ? size : 1)) return pointer;
+    throw bad_alloc();
+}
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+
+int main(int argc, char* argv[]) {
+    double bound = argc > 1 ? stod(argv[1]) : 1;
+    SimulationContext config;
+    config.num_nodes = 60;
+    config.malicious_percentage = 30;
+    config.meanTransactionTime = 10;
+    config.averageBlockArrivalTime = 100;
+    config.GetRequestTimeout = 20;
+    config.totalExecutionTime = 2000;
+    config.seed = 5;
+    try {
+        if (argc > 2 && !parseFlags(config, vector<string>(argv + 2, argv + argc))) {
+            cerr << "[ERROR] Unknown flag" << endl;
+            return 1;
+        }
+    } catch (const exception& e) {
+        cerr << "[ERROR] " << e.what() << endl;
+        return 1;
+    }
+    long long before = allocations.load();
+    SimulationResult result = runSimulation(config);
+    long long count = allocations.load() - before;
+    double perEvent = result.eventsProcessed > 0 ? (double)count / result.eventsProcessed : 0;
+    cout << "Events Processed: " << result.eventsProcessed << endl;
+    cout << "Allocations: " << count << endl;
+    cout << "Allocations Per Event: " << perEvent << endl;
+    if (perEvent > bound) {
+        cerr << "[ERROR] " << perEvent << " allocations per event, the bound is " << bound << endl;
+        return 1;
+    }
+    return 0;
+}
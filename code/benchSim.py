@@ -0,0 +1,145 @@
+import sys
+import subprocess
+import json
+import argparse
+import time
+import os
+import statistics
+from itertools import product
+
+# Parameter grids for the scaling benchmark. The execution time shrinks with the number of
+# nodes so that every point finishes in a reasonable amount of wall time.
+grids = {
+    "quick": {
+        "num_peers": [50, 100],
+        "percent_malicious": [30],
+        "Ttx": [10],
+        "Tk": [100],
+    },
+    "full": {
+        "num_peers": [100, 1000, 10000, 100000],
+        "percent_malicious": [10, 50],
+        "Ttx": [10, 100],
+        "Tk": [100, 600],
+    },
+}
+total_time_for_peers = {50: 2000, 100: 1000, 1000: 100, 10000: 10, 100000: 1}
+get_timeout = 20
+
+stats_keys = {
+    "Events Processed": "events",
+    "Simulated Time": "simulated_time",
+    "Simulation Wall Time": "simulation_wall_time",
+    "Post Run Wall Time": "post_run_wall_time",
+    "Events Per Second": "events_per_second",
+    "Simulated Time / Wall Time": "simulated_wall_ratio",
+    "Peak RSS (KB)": "peak_rss_kb",
+}
+
+
+def point_key(num_peer, percent_malicious, Ttx, Tk, total_time):
+    return f"{num_peer}_{percent_malicious}_{Ttx}_{Tk}_{total_time}"
+
+
+def run_point(num_peer, percent_malicious, Ttx, Tk, total_time, timeout, seed):
+    print(f"Running benchmark with num_peer={num_peer}, percent_malicious={percent_malicious}, Ttx={Ttx}, Tk={Tk}, total_time={total_time}, seed={seed}", flush=True)
+    start = time.time()
+    try:
+        output = subprocess.run(["./run", str(num_peer), str(percent_malicious), str(Ttx), str(Tk), str(get_timeout), str(total_time), "--stats", "--seed", str(seed)],
+                                capture_output=True, text=True, timeout=timeout).stdout
+    except subprocess.TimeoutExpired:
+        print(f"Timed out after {timeout} seconds")
+        return None
+    result = {"process_wall_time": time.time() - start}
+    for line in output.splitlines():
+        if ':' not in line:
+            continue
+        key, value = line.rsplit(':', 1)
+        if key in stats_keys:
+            result[stats_keys[key]] = float(value)
+    return result
+
+
+def run_point_repeated(num_peer, percent_malicious, Ttx, Tk, total_time, timeout, repeat, seed):
+    # Every repetition simulates the same seeded run, the median smooths out the noise of the wall time
+    runs = [run_point(num_peer, percent_malicious, Ttx, Tk, total_time, timeout, seed) for _ in range(repeat)]
+    runs = [r for r in runs if r is not None]
+    if not runs:
+        return None
+    return {key: statistics.median(r[key] for r in runs) for key in runs[0]}
+
+
+def compare(results, baseline, max_throughput_drop, max_memory_growth):
+    # Returns the list of regressions against the baseline
+    failures = []
+    for key, result in results.items():
+        if key not in baseline:
+            failures.append(f"{key}: no baseline entry, record one with --update-baseline")
+            continue
+        if result is None:
+            failures.append(f"{key}: run did not finish")
+            continue
+        base = baseline[key]
+        throughput = result["events_per_second"] / base["events_per_second"]
+        memory = result["peak_rss_kb"] / base["peak_rss_kb"]
+        print(f"{key}: throughput x{throughput:.3f}, peak RSS x{memory:.3f}")
+        if throughput < 1 - max_throughput_drop:
+            failures.append(f"{key}: events per second dropped to {throughput:.3f} of the baseline")
+        if memory > 1 + max_memory_growth:
+            failures.append(f"{key}: peak RSS grew to {memory:.3f} of the baseline")
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="End-to-end scaling benchmark of the simulator")
+    parser.add_argument("--grid", choices=grids.keys(), default="quick")
+    parser.add_argument("--baseline", default="bench_baseline.json")
+    parser.add_argument("--output", default="bench_results.json")
+    parser.add_argument("--update-baseline", action="store_true", help="overwrite the baseline with this run")
+    parser.add_argument("--max-throughput-drop", type=float, default=0.25, help="allowed fractional drop in events per second")
+    parser.add_argument("--max-memory-growth", type=float, default=0.5, help="allowed fractional growth in peak RSS")
+    parser.add_argument("--timeout", type=float, default=3600, help="wall time limit per run in seconds")
+    parser.add_argument("--repeat", type=int, default=3, help="runs per grid point, the median is reported")
+    parser.add_argument("--seed", type=int, default=1, help="seed of every run, the baseline is only comparable for the same seed")
+    args = parser.parse_args()
+
+    if not os.path.exists("./run"):
+        print("Build the simulator first with make")
+        sys.exit(1)
+
+    grid = grids[args.grid]
+    results = {}
+    for num_peer, percent_malicious, Ttx, Tk in product(grid["num_peers"], grid["percent_malicious"], grid["Ttx"], grid["Tk"]):
+        total_time = total_time_for_peers[num_peer]
+        key = point_key(num_peer, percent_malicious, Ttx, Tk, total_time)
+        results[key] = run_point_repeated(num_peer, percent_malicious, Ttx, Tk, total_time, args.timeout, args.repeat, args.seed)
+        print(results[key], flush=True)
+
+    with open(args.output, "w") as json_file:
+        json.dump(results, json_file, indent=4)
+    print(f"Results saved to {args.output}")
+
+    if args.update_baseline:
+        baseline = {}
+        if os.path.exists(args.baseline):
+            with open(args.baseline) as json_file:
+                baseline = json.load(json_file)
+        baseline.update({key: value for key, value in results.items() if value is not None})
+        with open(args.baseline, "w") as json_file:
+            json.dump(baseline, json_file, indent=4)
+        print(f"Baseline updated in {args.baseline}")
+        return
+
+    if not os.path.exists(args.baseline):
+        print(f"No baseline found at {args.baseline}, run with --update-baseline first")
+        sys.exit(1)
+    with open(args.baseline) as json_file:
+        baseline = json.load(json_file)
+    failures = compare(results, baseline, args.max_throughput_drop, args.max_memory_growth)
+    for failure in failures:
+        print(f"[REGRESSION] {failure}")
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,27 +1,31 @@
 #include "block.h"
 
-void Block::addTransaction(Transaction& txn) {
-    // Adds a transaction to the block
-    transactions.push_back(txn);
-}
-
-int Block::getBlocksize() {
+int Block::getBlocksize() const {
     // Returns the size of the block
     return blockSize;
 }
 
-string Block::getBlockHeaderHash() 
+int Block::getCompactSize() const {
+    return compactBlockHeaderSize + transactions.count * shortTransactionIDSize;
+}
+
+const string& Block::getBlockHeaderHash() const
+{
+    // The hash is set when the block is mined (or for the genesis block when it is created)
+    return hashBlockHeader;
+}
+
+const string& Block::getBlockHeaderHash(const TransactionTable& table, span<const TxIndex> transactions)
 {
     if (hashBlockHeader != "") return hashBlockHeader;
     string merkle_root = "";
-    for (auto txn : transactions) merkle_root += txn.getString();
+    for (TxIndex txn : transactions) merkle_root += table.get(txn).getString();
     merkle_root = sha256(merkle_root);
     string res = merkle_root;
     res += to_string(minerID);
     res += to_string(height);
     res += parentHash;
     res += to_string(timestamp_of_creation);
-    res = sha256(res);
-    hashBlockHeader = res;
-    return res;
+    hashBlockHeader = sha256(res);
+    return hashBlockHeader;
 }
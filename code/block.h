@@ -9,21 +9,24 @@
 using namespace std;
 
 extern const int blockSize;
+extern const int compactBlockHeaderSize;
+extern const int shortTransactionIDSize;
 
 class Block {
 public:
     Block() = default;
-    Block(string hashBlockHeader) : hashBlockHeader(hashBlockHeader) {}
-    void addTransaction(Transaction& txn);
+    Block(string hashBlockHeader) : hashBlockHeader(move(hashBlockHeader)) {}
     // int id;
     // int parentID;
-    vector<Transaction> transactions;
-    int minerID; 
-    int height;           
-    int getBlocksize();
+    TransactionSpan transactions; // Indices of the transactions in the TransactionTable of the simulation
+    int minerID = -1; // -1 for the genesis block
+    int height = 0;
+    int getBlocksize() const;
+    int getCompactSize() const; // Header and short ids of the transactions
     string hashBlockHeader = "";
     string parentHash = "";
-    string getBlockHeaderHash();
+    const string& getBlockHeaderHash() const;
+    const string& getBlockHeaderHash(const TransactionTable& table, span<const TxIndex> transactions); // Computes the hash of a new block
     int timestamp_of_creation = -1;
 };
 
@@ -1,31 +1,31 @@
 #include "blockchain.h"
 
-bool Blockchain::validateBlock(Block block) {
+bool Blockchain::validateBlock(const Block& block) {
     // This function checks if the block is valid or not
     if (blocks.find(block.parentHash) == blocks.end()) {
         // If the parent block is not present in the blockchain
         return false;
     }
     map<int, double> all_peer_balances; // calculating the peer balances from the blocks of the blockchain
-    for (int i = 0 ; i < num_nodes ; i ++ ) {
+    for (int i = 0 ; i < ctx.num_nodes ; i ++ ) {
         all_peer_balances[i] = initial_balance;
     }
-    Block current_block = block;
+    const Block* current_block = &block; // Walk the stored blocks instead of copying every one of them
     while (true) {
-        if (children_without_parent.count(current_block.hashBlockHeader)) {
+        if (children_without_parent.count(current_block->hashBlockHeader)) {
             // If the block is not present in the blockchain
             // then we can't validate the block
             return false;
         }
-        for (Transaction txn : current_block.transactions) {
-            all_peer_balances[txn.sender] -= txn.amount;
-            all_peer_balances[txn.receiver] += txn.amount;
+        for (TxIndex txn : ctx.transactions->block(current_block->transactions)) {
+            all_peer_balances[ctx.transactions->sender(txn)] -= ctx.transactions->amount(txn);
+            all_peer_balances[ctx.transactions->receiver(txn)] += ctx.transactions->amount(txn);
         }
-        all_peer_balances[current_block.minerID] += minerReward; // mining fee
-        if (current_block.parentHash == genesisHash or current_block.parentHash == "") break; // genesis block reached, we can break
-        current_block = blocks[current_block.parentHash];
+        all_peer_balances[current_block->minerID] += minerReward; // mining fee
+        if (current_block->parentHash == genesisHash or current_block->parentHash == "") break; // genesis block reached, we can break
+        current_block = &blocks[current_block->parentHash];
     }
-    for (int i = 0 ; i < num_nodes ; i ++ ) {
+    for (int i = 0 ; i < ctx.num_nodes ; i ++ ) {
         if (all_peer_balances[i] < 0) {
             // If the balance of any peer is negative, then the block is invalid
             return false;
@@ -38,55 +38,63 @@ double Blockchain::getPeerBalance(int peerID) {
     // This function returns the balance of the peer
     double balance = initial_balance;
     // cout << " leaf node" << returnLeafNode() << endl;
-    Block current_block = blocks[returnLeafNode()]; // get the leaf node
+    const Block* current_block = &blocks[current_leaf_node]; // get the leaf node
     while (true) {
-        if (children_without_parent.count(current_block.getBlockHeaderHash())) {
+        if (children_without_parent.count(current_block->getBlockHeaderHash())) {
             break;
         }
-        for (Transaction txn : current_block.transactions) {
-            if (txn.sender == peerID) balance -= txn.amount;
-            if (txn.receiver == peerID) balance += txn.amount;
+        for (TxIndex txn : ctx.transactions->block(current_block->transactions)) {
+            if (ctx.transactions->sender(txn) == peerID) balance -= ctx.transactions->amount(txn);
+            if (ctx.transactions->receiver(txn) == peerID) balance += ctx.transactions->amount(txn);
 
         }
-        if (current_block.minerID == peerID) balance += minerReward; // mining fee
-        // cout << " hello " << current_block.parentHash << " " << genesisHash << endl;
-        if (current_block.parentHash == genesisHash or current_block.parentHash == "") break; // reached the genesis block
-        current_block = blocks[current_block.parentHash];
+        if (current_block->minerID == peerID) balance += minerReward; // mining fee
+        // cout << " hello " << current_block->parentHash << " " << genesisHash << endl;
+        if (current_block->parentHash == genesisHash or current_block->parentHash == "") break; // reached the genesis block
+        current_block = &blocks[current_block->parentHash];
     }
     return balance;
 }
 
 bool Blockchain::insertBlock(Block block, double timestamp) {
     // This function inserts the block in the blockchain
-    if (blocks.find(block.getBlockHeaderHash()) == blocks.end()) block_to_timestamp[block.getBlockHeaderHash()] = timestamp; // Storing the timestamps for printing purposes (if the block comes back again, then no need to update the timestamp)
-    blocks[block.getBlockHeaderHash()] = block; // Map from id to block object
-    if (blocks.find(block.parentHash) == blocks.end()) {
+    if (headerOnly) {
+        // Keep the full block around for relaying and only store its header
+        cacheForRelay(block, timestamp);
+        block.transactions = TransactionSpan();
+    }
+    auto [slot, whether_new] = blocks.try_emplace(block.hashBlockHeader);
+    if (whether_new) block_to_timestamp[slot->first] = timestamp; // Storing the timestamps for printing purposes (if the block comes back again, then no need to update the timestamp)
+    slot->second = move(block); // Map from id to block object, the block is only referred to through the map from here on
+    const string& hash = slot->first;
+    const Block& stored = slot->second;
+    if (blocks.find(stored.parentHash) == blocks.end()) {
         // Child came before the parent, so for now we just return false, and add it when the parent reaches
-        children_without_parent.insert(block.getBlockHeaderHash());
+        children_without_parent.insert(hash);
         return true;
     }
-    string curr_hash = block.getBlockHeaderHash();
-    while(curr_hash != genesisHash && curr_hash != "") {
-        if (children_without_parent.count(curr_hash)) {
-            children_without_parent.insert(block.getBlockHeaderHash());
+    const string* curr_hash = &hash;
+    while(*curr_hash != genesisHash && *curr_hash != "") {
+        if (children_without_parent.count(*curr_hash)) {
+            children_without_parent.insert(hash);
             return true;
         }
-        curr_hash = blocks[curr_hash].parentHash;
+        curr_hash = &blocks[*curr_hash].parentHash;
     }
-    if (block.getBlockHeaderHash() != genesisHash && !validateBlock(block)) {
+    if (hash != genesisHash && !headerOnly && !validateBlock(stored)) {
         return false;
     } // If it is not the genesis block and the block is invalid, then return false
-    if (block.getBlockHeaderHash() != genesisHash) {
+    if (hash != genesisHash) {
         // map between parent and children
-        parent_block_id[block.getBlockHeaderHash()] = block.parentHash;
-        children_block_ids[block.parentHash].push_back(block.getBlockHeaderHash());
+        parent_block_id[hash] = stored.parentHash;
+        children_block_ids[stored.parentHash].push_back(hash);
     }
     
-    if (current_leaf_node == block.parentHash) current_leaf_node = block.getBlockHeaderHash(); // if the parent was previous leaf node, then update the leaf node
-    if (leafBlocks.find(block.parentHash) != leafBlocks.end()) leafBlocks.erase(block.parentHash); // parent is no longer a leaf node
-    leafBlocks.insert(block.getBlockHeaderHash()); // child is the new leaf node
-    int max_height = blocks[current_leaf_node].height; // the previous maximum height
     string prev_leaf_node = current_leaf_node;
+    if (current_leaf_node == stored.parentHash) current_leaf_node = hash; // if the parent was previous leaf node, then update the leaf node
+    if (leafBlocks.find(stored.parentHash) != leafBlocks.end()) leafBlocks.erase(stored.parentHash); // parent is no longer a leaf node
+    leafBlocks.insert(hash); // child is the new leaf node
+    int max_height = blocks[current_leaf_node].height; // the previous maximum height
     for (auto& b : leafBlocks) {
         // Updating the leaf node
         // This is essentially the logic for picking the chain with the maximum height
@@ -96,54 +104,32 @@ bool Blockchain::insertBlock(Block block, double timestamp) {
         }
     }
     string new_leaf_node = current_leaf_node;
-    if (prev_leaf_node != new_leaf_node) {
-        // We need to update the transaction pool of the peer, if we have a new leaf node
-        // We need to find the common ancestor of the two leaf nodes
-        // For this we keep going up the chain until we reach the same height
+    if (prev_leaf_node != new_leaf_node && !headerOnly) {
+        // Move the mempool of the peer from the previous leaf node to the new one: go up both chains to the
+        // common ancestor, disconnect the blocks of the old branch from the top and connect the new branch from the bottom
+        vector<string> newBranch;
         while(blocks[prev_leaf_node].height > blocks[new_leaf_node].height) {
-            for (Transaction &t : blocks[prev_leaf_node].transactions) {
-                if (peers[owner_id]->txPool.find(t) == peers[owner_id]->txPool.end()) {
-                    peers[owner_id]->txPool.insert(t);
-                }
-            }
+            ctx.peers[owner_id]->mempool.disconnectBlock(blocks[prev_leaf_node], blocks);
             prev_leaf_node = parent_block_id[prev_leaf_node];
         }
         while(blocks[new_leaf_node].height > blocks[prev_leaf_node].height) {
-            for (Transaction &t : blocks[new_leaf_node].transactions) {
-                if (peers[owner_id]->txPool.find(t) != peers[owner_id]->txPool.end()) {
-                    peers[owner_id]->txPool.erase(t);
-                }
-            }
+            newBranch.push_back(new_leaf_node);
             new_leaf_node = parent_block_id[new_leaf_node];
         }
         while (prev_leaf_node != new_leaf_node) {
-            for (Transaction &t : blocks[prev_leaf_node].transactions) {
-                if (peers[owner_id]->txPool.find(t) == peers[owner_id]->txPool.end()) {
-                    peers[owner_id]->txPool.insert(t);
-                }
-            }
-            for (Transaction &t : blocks[new_leaf_node].transactions) {
-                if (peers[owner_id]->txPool.find(t) != peers[owner_id]->txPool.end()) {
-                    peers[owner_id]->txPool.erase(t);
-                }
-            }
+            ctx.peers[owner_id]->mempool.disconnectBlock(blocks[prev_leaf_node], blocks);
+            newBranch.push_back(new_leaf_node);
             prev_leaf_node = parent_block_id[prev_leaf_node];
             new_leaf_node = parent_block_id[new_leaf_node];
         }
-    }
-    if (current_leaf_node == block.getBlockHeaderHash()) {
-        for (Transaction& t : block.transactions) {
-            if (peers[owner_id]->txPool.find(t) != peers[owner_id]->txPool.end()) {
-                peers[owner_id]->txPool.erase(t);
-            }
-        }
+        for (auto hash = newBranch.rbegin(); hash != newBranch.rend(); hash++) ctx.peers[owner_id]->mempool.connectBlock(blocks[*hash]);
     }
     for (string child : children_without_parent) {
         // We need to check if the children of the block can now be added
-        if (blocks[child].parentHash == block.getBlockHeaderHash()) {
+        if (blocks[child].parentHash == hash) {
             children_without_parent.erase(child); // Parent found
-            for (auto p : peers[owner_id]->neighbours)
-                peers[owner_id]->sendHash(blocks[child].getBlockHeaderHash(), p.second->id);
+            for (const auto& p : ctx.peers[owner_id]->neighbours)
+                ctx.peers[owner_id]->sendHash(blocks[child].getBlockHeaderHash(), p.second->id);
             insertBlock(blocks[child], timestamp); // Insert the block
             return true;
         }
@@ -151,6 +137,28 @@ bool Blockchain::insertBlock(Block block, double timestamp) {
     return true;
 }
 
+void Blockchain::cacheForRelay(const Block& block, double timestamp) {
+    // Remember the full block and evict the old ones, keeping at least relayCacheBlocks. A block which is
+    // already stored is being re-inserted after its parent arrived and only its header is left.
+    if (relayCache.count(block.getBlockHeaderHash()) || blocks.count(block.getBlockHeaderHash())) return;
+    relayCache[block.getBlockHeaderHash()] = block;
+    relayCacheOrder.push({timestamp, block.getBlockHeaderHash()});
+    double retention = relayCacheTime();
+    while (relayCacheOrder.size() > relayCacheBlocks && relayCacheOrder.front().first + retention <= timestamp) {
+        relayCache.erase(relayCacheOrder.front().second);
+        relayCacheOrder.pop();
+    }
+}
+
+double Blockchain::relayCacheTime() {
+    // The peer announces a block as soon as it arrives. A neighbour asks its announcers one after the other, each
+    // with a GET timeout, and it has at most maxNeighbours of them. With the countermeasure it may also hold the
+    // request back for up to the longest trust delay.
+    double retention = maxNeighbours * ctx.GetRequestTimeout;
+    if (ctx.enable_countermeasure) retention += ctx.peers[owner_id]->maxTrustDelay();
+    return retention;
+}
+
 string Blockchain::returnLeafNode () {
     return current_leaf_node; // Returns the current leaf node
 }
@@ -160,7 +168,7 @@ int Blockchain::getLongestChainHeight () {
     return blocks[leaf_node].height + 1; // Returns the height of the longest chain
 }
 
-void Blockchain::saveBlockChain(string filename) {
+void Blockchain::saveBlockChain(const string& filename) {
     // This function saves the blockchain to a file
     ofstream file(filename, ios::trunc);
     file << fixed;
@@ -168,7 +176,7 @@ void Blockchain::saveBlockChain(string filename) {
         if (b.first == "") continue;
         if(b.second.getBlockHeaderHash() == genesisHash) continue;
         file << b.second.getBlockHeaderHash() << "\t" << b.second.parentHash << "\t";
-        file << (b.second.minerID == ringMaster ? "Malicious" : "Honest") << "\t";
+        file << (b.second.minerID == ctx.ringMaster ? "Malicious" : "Honest") << "\t";
         file << block_to_timestamp[b.second.getBlockHeaderHash()] << "\t";
         file << b.second.height << "\n";
     }
@@ -185,4 +193,35 @@ vector<Block> Blockchain::currentChain() {
     }
     reverse(chain.begin(), chain.end());
     return chain;
-}
\ No newline at end of file
+}
+void Blockchain::saveState(CheckpointWriter& out) {
+    out.write(blocks);
+    out.write(parent_block_id);
+    out.write(children_block_ids);
+    out.write(leafBlocks);
+    out.write(current_leaf_node);
+    out.write(block_to_timestamp);
+    out.write(children_without_parent);
+    out.write(hash_to_queue);
+    out.write(hash_to_timeout);
+    out.write(whether_sent_to_honest);
+    out.write(headerOnly);
+    out.write(relayCache);
+    out.write(relayCacheOrder);
+}
+
+void Blockchain::loadState(CheckpointReader& in) {
+    in.read(blocks);
+    in.read(parent_block_id);
+    in.read(children_block_ids);
+    in.read(leafBlocks);
+    in.read(current_leaf_node);
+    in.read(block_to_timestamp);
+    in.read(children_without_parent);
+    in.read(hash_to_queue);
+    in.read(hash_to_timeout);
+    in.read(whether_sent_to_honest);
+    in.read(headerOnly);
+    in.read(relayCache);
+    in.read(relayCacheOrder);
+}
@@ -5,6 +5,8 @@
 #include "block.h"
 #include "transaction.h"
 #include "helper.h"
+#include "context.h"
+#include "checkpoint.h"
 #include <vector>
 #include <map>
 #include <set>
@@ -12,23 +14,23 @@
 #include <queue>
 using namespace std;
 
-// Referring variables from main.cpp
+// Referring variables from constants.cpp
 extern const double initial_balance;
-extern int num_nodes;
-
 extern const double minerReward;
 extern const string genesisHash;
-extern bool debug;
+
+constexpr size_t relayCacheBlocks = 32; // Full blocks a header only blockchain keeps at least, however old they are
 
 class Blockchain {
     public:
-        Blockchain(int owner_id) { this->owner_id = owner_id; }
+        Blockchain(SimulationContext& ctx, int owner_id) : ctx(ctx), owner_id(owner_id) {}
+        SimulationContext& ctx;
         int owner_id;
         map<string, Block> blocks;
         map<string, string> parent_block_id;
         map<string, vector<string>> children_block_ids;
         bool insertBlock(Block block, double timestamp);
-        bool validateBlock(Block block);
+        bool validateBlock(const Block& block);
         set<string> leafBlocks;
         string current_leaf_node = "";
         string returnLeafNode();
@@ -36,11 +38,21 @@ class Blockchain {
         int getLongestChainHeight ();
         map<string, double> block_to_timestamp;
         multiset<string> children_without_parent;
-        void saveBlockChain(string filename);
+        void saveBlockChain(const string& filename);
         vector<Block> currentChain();
         map<string, queue<int>> hash_to_queue;
         map<string, int> hash_to_timeout;
         map<string, bool> whether_sent_to_honest;
+        // A header only blockchain (used by relay only peers) drops the transactions of the blocks it stores,
+        // skips the balance validation and keeps the recent full blocks in relayCache to serve GET requests. A block
+        // leaves the cache once a GET request for it can no longer be on its way (see relayCacheTime)
+        bool headerOnly = false;
+        map<string, Block> relayCache;
+        queue<pair<double, string>> relayCacheOrder; // Arrival time of every cached block, oldest first
+        void cacheForRelay(const Block& block, double timestamp);
+        double relayCacheTime();
+        void saveState(CheckpointWriter& out);
+        void loadState(CheckpointReader& in);
 };
 
 #endif 
@@ -0,0 +1,103 @@
+#include "checkpoint.h"
+
+void CheckpointWriter::write(const Block& block) {
+    write(block.transactions);
+    write(block.minerID);
+    write(block.height);
+    write(block.hashBlockHeader);
+    write(block.parentHash);
+    write(block.timestamp_of_creation);
+}
+
+void CheckpointWriter::write(const Event& event) {
+    write(event.time);
+    write(event.type);
+    write(event.sourcePeer);
+    write(event.targetPeer);
+    write(event.whether_overlay);
+    write(event.sequence);
+    write(event.data.index());
+    if (holds_alternative<TxIndex>(event.data)) write(get<TxIndex>(event.data));
+    else if (holds_alternative<Block>(event.data)) write(get<Block>(event.data));
+    else if (holds_alternative<string>(event.data)) write(get<string>(event.data));
+    else write(get<vector<TxIndex>>(event.data));
+}
+
+void CheckpointWriter::write(const LinkTable& links) {
+    write(links.offsets);
+    write(links.targets);
+    write(links.params);
+}
+
+void CheckpointWriter::write(const TransactionTable& table) {
+    write((size_t)table.size());
+    for (TxIndex txn = 0; txn < table.size(); txn++) write(table.get(txn));
+    write((size_t)table.blockTransactionCount());
+    for (uint32_t i = 0; i < table.blockTransactionCount(); i++) write(table.blockTransaction(i));
+}
+
+void CheckpointWriter::close() {
+    file.close();
+    if (!file) throw runtime_error("Unable to finish writing the checkpoint file");
+}
+
+void CheckpointReader::read(Block& block) {
+    read(block.transactions);
+    read(block.minerID);
+    read(block.height);
+    read(block.hashBlockHeader);
+    read(block.parentHash);
+    read(block.timestamp_of_creation);
+}
+
+void CheckpointReader::read(Event& event) {
+    read(event.time);
+    read(event.type);
+    read(event.sourcePeer);
+    read(event.targetPeer);
+    read(event.whether_overlay);
+    read(event.sequence);
+    size_t index;
+    read(index);
+    if (index == 0) {
+        TxIndex txn;
+        read(txn);
+        event.data = txn;
+    } else if (index == 1) {
+        Block block;
+        read(block);
+        event.data = move(block);
+    } else if (index == 2) {
+        string hash;
+        read(hash);
+        event.data = move(hash);
+    } else {
+        vector<TxIndex> transactions;
+        read(transactions);
+        event.data = move(transactions);
+    }
+}
+
+void CheckpointReader::read(TransactionTable& table) {
+    // Into an empty table, so every transaction gets back its index
+    for (size_t n = readSize(); n > 0; n--) {
+        Transaction txn;
+        read(txn);
+        table.append(txn);
+    }
+    // The block lists go back one chunk at a time, which keeps the padding of the chunks where it was
+    size_t remaining = readSize();
+    vector<TxIndex> chunk;
+    while (remaining > 0) {
+        chunk.resize(min<size_t>(remaining, ChunkedArray<TxIndex>::chunkSize));
+        for (TxIndex& txn : chunk) read(txn);
+        table.appendBlock(chunk);
+        remaining -= chunk.size();
+    }
+}
+
+void CheckpointReader::read(LinkTable& links) {
+    read(links.offsets);
+    read(links.targets);
+    read(links.params);
+}
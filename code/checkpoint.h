@@ -0,0 +1,124 @@
+/* This file contains the binary reader and writer of the simulation checkpoints */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <fstream>
+#include <map>
+#include <queue>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "block.h"
+#include "event.h"
+#include "topology.h"
+using namespace std;
+
+constexpr char checkpointMagic[8] = {'S', 'M', 'C', 'K', 'P', 'T', '1', '1'};
+
+// Writes values in the layout of the machine, lengths first for the containers. Plain values (numbers, the
+// random streams, transactions) are copied byte for byte.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(const string& path) : file(path, ios::binary) {
+        if (!file) throw runtime_error("Unable to write checkpoint file: " + path);
+    }
+    template <typename T> requires is_trivially_copyable_v<T>
+    void write(const T& value) { file.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+    void write(const string& value) {
+        write(value.size());
+        file.write(value.data(), value.size());
+    }
+    template <typename A, typename B> void write(const pair<A, B>& value) {
+        write(value.first);
+        write(value.second);
+    }
+    template <typename T> void write(const vector<T>& values) {
+        write(values.size());
+        for (const T& value : values) write(value);
+    }
+    template <typename T> void write(const set<T>& values) { writeRange(values); }
+    template <typename T> void write(const multiset<T>& values) { writeRange(values); }
+    template <typename K, typename V> void write(const map<K, V>& values) { writeRange(values); }
+    template <typename T> void write(queue<T> values) {
+        write(values.size());
+        for (; !values.empty(); values.pop()) write(values.front());
+    }
+    void write(const Block& block);
+    void write(const Event& event);
+    void write(const LinkTable& links);
+    void write(const TransactionTable& table);
+    void close();
+private:
+    ofstream file;
+    template <typename Range> void writeRange(const Range& values) {
+        write(values.size());
+        for (const auto& value : values) write(value);
+    }
+};
+
+// Reads back what CheckpointWriter wrote, in the same order
+class CheckpointReader {
+public:
+    explicit CheckpointReader(const string& path) : file(path, ios::binary) {
+        if (!file) throw runtime_error("Unable to open checkpoint file: " + path);
+    }
+    template <typename T> requires is_trivially_copyable_v<T>
+    void read(T& value) {
+        if (!file.read(reinterpret_cast<char*>(&value), sizeof(T))) throw runtime_error("Checkpoint file is truncated");
+    }
+    void read(string& value) {
+        value.resize(readSize());
+        if (!file.read(value.data(), value.size())) throw runtime_error("Checkpoint file is truncated");
+    }
+    template <typename A, typename B> void read(pair<A, B>& value) {
+        read(value.first);
+        read(value.second);
+    }
+    template <typename T> void read(vector<T>& values) {
+        values.resize(readSize());
+        for (T& value : values) read(value);
+    }
+    template <typename T> void read(set<T>& values) { readSorted(values); }
+    template <typename T> void read(multiset<T>& values) { readSorted(values); }
+    template <typename K, typename V> void read(map<K, V>& values) {
+        values.clear();
+        for (size_t n = readSize(); n > 0; n--) {
+            pair<K, V> value;
+            read(value);
+            values.emplace_hint(values.end(), move(value));
+        }
+    }
+    template <typename T> void read(queue<T>& values) {
+        values = queue<T>();
+        for (size_t n = readSize(); n > 0; n--) {
+            T value;
+            read(value);
+            values.push(move(value));
+        }
+    }
+    void read(Block& block);
+    void read(Event& event);
+    void read(LinkTable& links);
+    void read(TransactionTable& table);
+    size_t readSize() {
+        size_t size;
+        read(size);
+        return size;
+    }
+private:
+    ifstream file;
+    template <typename Sorted> void readSorted(Sorted& values) {
+        // The values were written in order, so every insertion goes to the end
+        values.clear();
+        for (size_t n = readSize(); n > 0; n--) {
+            typename Sorted::value_type value;
+            read(value);
+            values.emplace_hint(values.end(), move(value));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,18 @@
+// Constants of the simulation, shared by the simulator binary and the shared library
+#include <string>
+using namespace std;
+
+extern const double minerReward = 50;
+extern const int maxTransactionsPerBlock = 999;
+extern const int TransactionSize = 8000;
+extern const int hashSize = 512;
+extern const int broadcastPrivateChainSize = 512;
+extern const int getSize = 560;
+extern const int inventoryEntrySize = 288; // 36 bytes per transaction in an inventory or getdata message
+extern const int blockSize = 8000000;
+extern const int compactBlockHeaderSize = 704; // Header and nonce of a compact block, 88 bytes
+extern const int shortTransactionIDSize = 48;  // 6 bytes per transaction in a compact block or a request for its transactions
+extern const string genesisHash = "genesis";
+extern const string BlockChainSaveDirectory = "blockchain_data/";
+extern const double initial_balance = 0;
+extern const int recentBalanceVersions = 64; // Balances versions kept alive for the reorganisations whatever the mempools hold
@@ -0,0 +1,102 @@
+/* This file contains the state shared by all the objects of one simulation */
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "topology.h"
+#include "transaction.h"
+using namespace std;
+
+class Peer; // Forward declaration of the class Peer
+class BalanceCache;
+
+// Whether the messages of a peer queue behind each other, see --link-model
+enum LinkModel {
+    INDEPENDENT_LINKS, // Every message has its link to itself
+    UPLINK_QUEUE,      // One queue for all the messages of the sender
+    EDGE_QUEUE,        // One queue per directed edge
+};
+
+// How a peer passes transactions on, see --tx-relay
+enum TxRelayMode {
+    FLOOD_TX_RELAY, // Every transaction to every neighbour
+    INV_TX_RELAY,   // Announced in batches, sent on request
+};
+
+// How a peer answers a GET request, see --block-relay
+enum BlockRelayMode {
+    FULL_BLOCK_RELAY,    // The whole block
+    COMPACT_BLOCK_RELAY, // Short ids, the block is rebuilt from the mempool of the receiver
+};
+
+// Everything a simulation reads or writes outside of its own objects. Each Simulator owns one context,
+// so independent simulations can run side by side in one process.
+struct SimulationContext {
+    // Parameters of the run
+    int num_nodes = 0;
+    double malicious_percentage = 0;
+    double meanTransactionTime = 10;
+    double averageBlockArrivalTime = 600;
+    int GetRequestTimeout = 0;
+    int totalExecutionTime = 0;
+    bool whether_ratio = false;
+    bool whether_longest_chain_height = false;
+    bool whether_blockchain = false;
+    bool whether_branches = false;
+    bool show_network = false;
+    bool enable_countermeasure = false;
+    bool whether_dump_all = false;
+    bool whether_eclipse_attack = true;
+    bool whether_stats = false;
+    bool whether_logging = true; // Write the per peer log files
+    bool debug = false;
+    int num_threads = 1;
+    int num_observers = -1; // Honest peers keeping a full ledger when the other honest peers are relay only (-1 disables)
+    string topologyFile = "";
+    string logDirectory = "logFiles";
+    string countermeasureDirectory = "countermeasure";
+    long long memoryBudgetMB = 0; // Abort the run when the memory usage crosses this value (0 disables the check)
+    double memorySampleInterval = 100; // Simulated time between two memory samples
+    double checkpointAt = -1;          // Simulated time at which the state is written to checkpointFile (-1 disables)
+    string checkpointFile = "";
+    string restoreFile = "";           // Start from this checkpoint instead of setting up a new network
+    bool antithetic = false;           // Mirror the numbers of the peer streams, the topology streams are left as they are
+    string engine = "event";           // "event" for the full simulation, "markov" for the selfish mining state machine
+    double markovGamma = -1;           // Share of the honest hash power that mines on the pool block in a race (-1 calibrates it)
+    int markovRuns = 10000;            // Monte Carlo runs of the Markov engine
+    int calibrationRuns = 3;           // Full simulations used to estimate gamma
+    int calibrationTime = 5000;        // Time of execution of every calibration run (capped by the time of execution)
+    long long forkSeed = -1;           // Reseed the peers after the restore so the run takes another future (-1 keeps the checkpoint streams)
+    TxRelayMode txRelay = FLOOD_TX_RELAY; // Every transaction to every neighbour, or announcements in batches
+    BlockRelayMode blockRelay = FULL_BLOCK_RELAY; // Whole blocks, or compact blocks rebuilt from the mempool of the receiver
+    double trickleInterval = 2;        // Simulated time a peer collects transactions before announcing them with --tx-relay inv
+    LinkModel linkModel = INDEPENDENT_LINKS; // Independent messages, or messages queued behind each other per uplink or per edge
+    bool blockPriority = false;        // With a link queue, block traffic does not wait for transaction traffic
+    string trafficFile = "";           // Cumulative messages and bytes per event type and link class, sampled over the run
+    double trafficSampleInterval = 100; // Simulated time between two traffic samples
+    string trafficEdgesFile = "";      // Messages and bytes of every directed edge at the end of the run
+    int getFanout = 1;                 // GET requests a peer keeps in flight for one block, each to another announcer
+    double getStagger = 0;             // Simulated time between two of the parallel GET requests for one block
+    bool headerFirst = false;          // Announce a received block once its header links to a known block, before it is validated
+    double validationDelay = 0;        // Simulated time a peer takes to validate a received block
+
+    // State of the run
+    vector<Peer*> peers;
+    TransactionTable* transactions = nullptr; // Owned by the Simulator
+    BalanceCache* balances = nullptr;         // Owned by the Simulator
+    uint64_t seed = ((uint64_t)random_device{}() << 32) | random_device{}(); // Key of every random stream of the run
+    int current_block_id = 0;
+    int broadcastnumber = 0;
+    int ringMaster = -1;
+    LinkTable honestLinks;
+    LinkTable overlayLinks;
+    vector<int> topologyMaliciousPeers;
+
+    int generateBlockID() { return current_block_id++; }
+    int getBroadCastNumber() { return broadcastnumber++; }
+};
+
+#endif
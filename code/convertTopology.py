@@ -0,0 +1,79 @@
+import sys
+import struct
+
+# Converts network topologies between the text format and the binary format read by ./run --topology
+#
+# Text format, one entry per line ('#' starts a comment):
+#   nodes <number-of-nodes>
+#   malicious <id> <id> ...
+#   honest <u> <v> <bandwidth-in-bits-per-second> <propagation-delay-in-ms>
+#   overlay <u> <v> <bandwidth-in-bits-per-second> <propagation-delay-in-ms>
+
+MAGIC = b"SMTOPO01"
+HEADER = struct.Struct("<8sIIII")
+EDGE = struct.Struct("<IIff")
+
+
+def read_text(path):
+    num_nodes, malicious, honest, overlay = 0, [], [], []
+    with open(path) as file:
+        for line_number, line in enumerate(file, 1):
+            fields = line.split('#')[0].split()
+            if not fields:
+                continue
+            kind = fields[0]
+            if kind == "nodes":
+                num_nodes = int(fields[1])
+            elif kind == "malicious":
+                malicious.extend(int(x) for x in fields[1:])
+            elif kind in ("honest", "overlay"):
+                edge = (int(fields[1]), int(fields[2]), float(fields[3]), float(fields[4]))
+                (honest if kind == "honest" else overlay).append(edge)
+            else:
+                raise ValueError(f"{path}:{line_number}: unknown entry '{kind}'")
+    return num_nodes, malicious, honest, overlay
+
+
+def write_binary(path, num_nodes, malicious, honest, overlay):
+    with open(path, "wb") as file:
+        file.write(HEADER.pack(MAGIC, num_nodes, len(malicious), len(honest), len(overlay)))
+        file.write(struct.pack(f"<{len(malicious)}I", *malicious))
+        for edge in honest + overlay:
+            file.write(EDGE.pack(*edge))
+
+
+def read_binary(path):
+    with open(path, "rb") as file:
+        data = file.read()
+    magic, num_nodes, num_malicious, num_honest, num_overlay = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError(f"{path} is not a topology file")
+    offset = HEADER.size
+    malicious = list(struct.unpack_from(f"<{num_malicious}I", data, offset))
+    offset += 4 * num_malicious
+    edges = [EDGE.unpack_from(data, offset + i * EDGE.size) for i in range(num_honest + num_overlay)]
+    return num_nodes, malicious, edges[:num_honest], edges[num_honest:]
+
+
+def write_text(path, num_nodes, malicious, honest, overlay):
+    with open(path, "w") as file:
+        file.write(f"nodes {num_nodes}\n")
+        file.write("malicious " + " ".join(map(str, malicious)) + "\n")
+        for kind, edges in (("honest", honest), ("overlay", overlay)):
+            for u, v, bandwidth, delay in edges:
+                file.write(f"{kind} {u} {v} {bandwidth:g} {delay:g}\n")
+
+
+def main():
+    if len(sys.argv) != 4 or sys.argv[1] not in ("to-binary", "to-text"):
+        print("Usage: python3 convertTopology.py to-binary <text-file> <binary-file>")
+        print("       python3 convertTopology.py to-text <binary-file> <text-file>")
+        sys.exit(1)
+    if sys.argv[1] == "to-binary":
+        write_binary(sys.argv[3], *read_text(sys.argv[2]))
+    else:
+        write_text(sys.argv[3], *read_binary(sys.argv[2]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,471 @@
+#include "driver.h"
+#include "simulator.h"
+#include "markov.h"
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <stdexcept>
+
+template <typename Mode>
+static Mode parseMode(const string& flag, const string& value, const vector<pair<string, Mode>>& modes) {
+    // The command line, the sweep and the C API all build their contexts here, so none of them can run a misspelt mode
+    string names;
+    for (int i = 0; i < (int)modes.size(); i++) {
+        if (modes[i].first == value) return modes[i].second;
+        names += (i == 0 ? "" : i + 1 == (int)modes.size() ? " or " : ", ") + modes[i].first;
+    }
+    throw invalid_argument("Unknown value " + value + " of " + flag + ", use " + names);
+}
+
+bool parseFlags(SimulationContext& ctx, const vector<string>& args) {
+    // Apply the command line flags to the context, returns false on a flag which is not known and throws
+    // invalid_argument on a value which is not valid
+    bool valid = true;
+    for (int i = 0 ; i < (int)args.size() ; i ++ ) {
+        bool hasValue = i + 1 < (int)args.size();
+        if (args[i] == "--ratio") {
+            ctx.whether_ratio = true;
+        } else if (args[i] == "--longest-chain-height") {
+            ctx.whether_longest_chain_height = true;
+        } else if (args[i] == "--blockchain") {
+            ctx.whether_blockchain = true;
+        } else if (args[i] == "--branches") {
+            ctx.whether_branches = true;
+        } else if (args[i] == "--show-network") {
+            ctx.show_network = true;
+        } else if (args[i] == "--countermeasure") {
+            ctx.enable_countermeasure = true;
+        } else if (args[i] == "--dump-all") {
+            ctx.whether_dump_all = true;
+        } else if (args[i] == "--no-eclipse") {
+            ctx.whether_eclipse_attack = false;
+        } else if (args[i] == "--stats") {
+            ctx.whether_stats = true;
+        } else if (args[i] == "--seed" && hasValue) {
+            ctx.seed = stoull(args[++i]);
+        } else if (args[i] == "--threads" && hasValue) {
+            ctx.num_threads = max(1, stoi(args[++i]));
+        } else if (args[i] == "--topology" && hasValue) {
+            ctx.topologyFile = args[++i];
+        } else if (args[i] == "--observers" && hasValue) {
+            ctx.num_observers = stoi(args[++i]);
+        } else if (args[i] == "--memory-budget" && hasValue) {
+            ctx.memoryBudgetMB = stoll(args[++i]);
+        } else if (args[i] == "--memory-sample-interval" && hasValue) {
+            ctx.memorySampleInterval = stod(args[++i]);
+        } else if (args[i] == "--checkpoint-at" && hasValue) {
+            ctx.checkpointAt = stod(args[++i]);
+        } else if (args[i] == "--checkpoint-out" && hasValue) {
+            ctx.checkpointFile = args[++i];
+        } else if (args[i] == "--restore" && hasValue) {
+            ctx.restoreFile = args[++i];
+        } else if (args[i] == "--fork-seed" && hasValue) {
+            ctx.forkSeed = stoll(args[++i]);
+        } else if (args[i] == "--engine" && hasValue) {
+            ctx.engine = args[++i];
+        } else if (args[i].starts_with("--engine=")) {
+            ctx.engine = args[i].substr(9);
+        } else if (args[i] == "--tx-relay" && hasValue) {
+            ctx.txRelay = parseMode<TxRelayMode>(args[i], args[i + 1], {{"flood", FLOOD_TX_RELAY}, {"inv", INV_TX_RELAY}});
+            i++;
+        } else if (args[i] == "--block-relay" && hasValue) {
+            ctx.blockRelay = parseMode<BlockRelayMode>(args[i], args[i + 1], {{"full", FULL_BLOCK_RELAY}, {"compact", COMPACT_BLOCK_RELAY}});
+            i++;
+        } else if (args[i] == "--link-model" && hasValue) {
+            ctx.linkModel = parseMode<LinkModel>(args[i], args[i + 1], {{"independent", INDEPENDENT_LINKS}, {"uplink", UPLINK_QUEUE}, {"edge", EDGE_QUEUE}});
+            i++;
+        } else if (args[i] == "--block-priority") {
+            ctx.blockPriority = true;
+        } else if (args[i] == "--traffic-out" && hasValue) {
+            ctx.trafficFile = args[++i];
+        } else if (args[i] == "--traffic-interval" && hasValue) {
+            ctx.trafficSampleInterval = stod(args[++i]);
+        } else if (args[i] == "--traffic-edges" && hasValue) {
+            ctx.trafficEdgesFile = args[++i];
+        } else if (args[i] == "--get-fanout" && hasValue) {
+            ctx.getFanout = max(1, stoi(args[++i]));
+        } else if (args[i] == "--get-stagger" && hasValue) {
+            ctx.getStagger = stod(args[++i]);
+        } else if (args[i] == "--header-first") {
+            ctx.headerFirst = true;
+        } else if (args[i] == "--validation-delay" && hasValue) {
+            ctx.validationDelay = stod(args[++i]);
+        } else if (args[i] == "--trickle-interval" && hasValue) {
+            ctx.trickleInterval = stod(args[++i]);
+        } else if (args[i] == "--gamma" && hasValue) {
+            ctx.markovGamma = stod(args[++i]);
+        } else if (args[i] == "--markov-runs" && hasValue) {
+            ctx.markovRuns = max(1, stoi(args[++i]));
+        } else if (args[i] == "--calibration-runs" && hasValue) {
+            ctx.calibrationRuns = max(1, stoi(args[++i]));
+        } else if (args[i] == "--calibration-time" && hasValue) {
+            ctx.calibrationTime = stoi(args[++i]);
+        } else if (args[i] == "--antithetic") {
+            ctx.antithetic = true;
+        } else if (args[i] == "--debug") {
+            ctx.debug = true;
+        } else {
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+SimulationResult runSimulation(const SimulationContext& config, const function<void(SimulationContext&)>& inspect) {
+    // Run one simulation in this thread, nothing is printed or written to the log files. The optional inspect
+    // callback sees the finished state before the peers are freed.
+    auto start = chrono::steady_clock::now();
+    Simulator simulator(config);
+    simulator.ctx.whether_logging = false;
+    if (config.restoreFile != "") simulator.restoreCheckpoint(config.restoreFile);
+    else simulator.setup();
+    simulator.run();
+    SimulationResult result;
+    if (simulator.ctx.ringMaster != -1) {
+        RatioResult ratios = computeRatios(simulator.ctx);
+        result.ratio_malicious_total = ratios.ratio_malicious_total;
+        result.ratio_malicious_totalMalicious = ratios.ratio_malicious_totalMalicious;
+        result.numMaliciousBlocks_chain = ratios.numMaliciousBlocks_chain;
+        result.numHonestBlocks_chain = ratios.numHonestBlocks_chain;
+        result.totalMaliciousBlocks = ratios.totalMaliciousBlocks;
+        result.calibration = countCalibration(simulator.ctx);
+    }
+    if (inspect) inspect(simulator.ctx);
+    result.eventsProcessed = simulator.eventsProcessed;
+    result.wallTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static SimulationResult runAntitheticPair(SimulationContext config) {
+    // Run the seed once as it is and once mirrored, the pair counts as one replication with the average of both
+    config.antithetic = false;
+    SimulationResult first = runSimulation(config);
+    config.antithetic = true;
+    SimulationResult second = runSimulation(config);
+    SimulationResult result;
+    result.ratio_malicious_total = (first.ratio_malicious_total + second.ratio_malicious_total) / 2;
+    result.ratio_malicious_totalMalicious = (first.ratio_malicious_totalMalicious + second.ratio_malicious_totalMalicious) / 2;
+    result.numMaliciousBlocks_chain = (first.numMaliciousBlocks_chain + second.numMaliciousBlocks_chain) / 2;
+    result.numHonestBlocks_chain = (first.numHonestBlocks_chain + second.numHonestBlocks_chain) / 2;
+    result.totalMaliciousBlocks = (first.totalMaliciousBlocks + second.totalMaliciousBlocks) / 2;
+    result.eventsProcessed = (first.eventsProcessed + second.eventsProcessed) / 2;
+    result.wallTime = first.wallTime + second.wallTime;
+    return result;
+}
+
+static vector<string> splitList(const string& value, char separator) {
+    // Split a list of values and trim the spaces around each of them
+    vector<string> items;
+    stringstream stream(value);
+    string item;
+    while (getline(stream, item, separator)) {
+        size_t begin = item.find_first_not_of(" \t"), end = item.find_last_not_of(" \t");
+        items.push_back(begin == string::npos ? "" : item.substr(begin, end - begin + 1));
+    }
+    return items;
+}
+
+SweepSpec parseSweepSpec(const string& path) {
+    // Read a sweep specification, one `key = value, value, ...` line per parameter.
+    // The flag combinations are separated by '|' and `none` stands for no flags.
+    ifstream file(path);
+    if (!file.is_open()) throw runtime_error("Unable to open sweep specification: " + path);
+    SweepSpec spec;
+    string line;
+    int line_number = 0;
+    while (getline(file, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        size_t equals = line.find('=');
+        if (line.find_first_not_of(" \t\r") == string::npos) continue;
+        if (equals == string::npos) throw runtime_error(path + ":" + to_string(line_number) + ": expected key = value");
+        string key = splitList(line.substr(0, equals), '\n')[0];
+        string value = line.substr(equals + 1);
+        if (!value.empty() && value.back() == '\r') value.pop_back();
+        auto ints = [&]() { vector<int> v; for (auto& x : splitList(value, ',')) v.push_back(stoi(x)); return v; };
+        auto doubles = [&]() { vector<double> v; for (auto& x : splitList(value, ',')) v.push_back(stod(x)); return v; };
+        if (key == "num_nodes") spec.num_nodes = ints();
+        else if (key == "percent_malicious") spec.percent_malicious = doubles();
+        else if (key == "Ttx") spec.Ttx = doubles();
+        else if (key == "Tk") spec.Tk = doubles();
+        else if (key == "get_timeout") spec.get_timeout = ints();
+        else if (key == "total_time") spec.total_time = ints();
+        else if (key == "flags") {
+            spec.flags = splitList(value, '|');
+            for (auto& flags : spec.flags) if (flags == "none") flags = "";
+        }
+        else if (key == "replications") spec.replications = stoi(value);
+        else if (key == "ci_target") spec.ci_target = stod(value);
+        else if (key == "paired") spec.paired = splitList(value, '\n')[0] == "true";
+        else if (key == "antithetic") spec.antithetic = splitList(value, '\n')[0] == "true";
+        else if (key == "max_replications") spec.max_replications = stoi(value);
+        else if (key == "threads") spec.threads = stoi(value);
+        else if (key == "seed") spec.seed = stoll(value);
+        else if (key == "output") spec.output = splitList(value, '\n')[0];
+        else throw runtime_error(path + ":" + to_string(line_number) + ": unknown key " + key);
+    }
+    return spec;
+}
+
+// Fixed size pool in which every worker owns a deque of jobs and steals from the back of the
+// other deques once its own one is empty
+class WorkStealingPool {
+public:
+    WorkStealingPool(int workers) : queues(workers), locks(workers) {}
+    void push(int worker, int job) {
+        lock_guard<mutex> guard(locks[worker]);
+        queues[worker].push_back(job);
+    }
+    void run(const function<void(int)>& execute) {
+        vector<thread> threads;
+        for (int worker = 0; worker < (int)queues.size(); worker++) {
+            threads.emplace_back([this, worker, &execute]() {
+                int job;
+                while (next(worker, job)) execute(job);
+            });
+        }
+        for (auto& t : threads) t.join();
+    }
+private:
+    vector<deque<int>> queues;
+    vector<mutex> locks;
+    bool next(int worker, int& job) {
+        {
+            lock_guard<mutex> guard(locks[worker]);
+            if (!queues[worker].empty()) {
+                job = queues[worker].front();
+                queues[worker].pop_front();
+                return true;
+            }
+        }
+        for (int offset = 1; offset < (int)queues.size(); offset++) {
+            int victim = (worker + offset) % queues.size();
+            lock_guard<mutex> guard(locks[victim]);
+            if (!queues[victim].empty()) {
+                job = queues[victim].back();
+                queues[victim].pop_back();
+                return true;
+            }
+        }
+        return false; // No job is queued anywhere, and jobs never create new jobs
+    }
+};
+
+static double studentT975(int degreesOfFreedom) {
+    // Two sided 95% quantile of the t distribution
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degreesOfFreedom < 1) return NAN;
+    if (degreesOfFreedom <= 30) return table[degreesOfFreedom - 1];
+    return 1.96;
+}
+
+// Running mean and variance (Welford) of the values which are not NaN, with the half width of their 95% confidence interval
+struct RunningStat {
+    int count = 0;
+    double average = 0;
+    double squares = 0; // Sum of the squared distances to the mean
+    void add(double value) {
+        if (isnan(value)) return;
+        count++;
+        double delta = value - average;
+        average += delta / count;
+        squares += delta * (value - average);
+    }
+    double mean() const { return count ? average : NAN; }
+    double ci() const { return count > 1 ? studentT975(count - 1) * sqrt(squares / (count - 1) / count) : NAN; }
+    int runsForHalfWidth(double target) const {
+        // Number of values at which the current spread would give the target half width
+        if (count < 2) return count + 1;
+        double needed = pow(1.96 * sqrt(squares / (count - 1)) / target, 2);
+        return needed > 1e9 ? 1e9 : (int)ceil(needed);
+    }
+};
+
+static string jsonNumber(double value) {
+    if (isnan(value) || isinf(value)) return "null";
+    ostringstream out;
+    out.precision(10);
+    out << value;
+    return out.str();
+}
+
+static string jsonString(const string& value) {
+    // Quoted, with the characters JSON does not allow inside a string escaped
+    ostringstream out;
+    out << '"';
+    for (unsigned char c : value) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (c == '\n') out << "\\n";
+        else if (c == '\t') out << "\\t";
+        else if (c < 0x20) out << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec;
+        else out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+static string csvString(const string& value) {
+    // Quoted, with the quotes inside doubled
+    string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+int runSweep(const SweepSpec& spec) {
+    // Expand the grid into jobs, run them on the thread pool and write the aggregated results
+    struct Point { int num_nodes; double percent_malicious, Ttx, Tk; int get_timeout, total_time; string flags; };
+    vector<Point> points;
+    for (int n : spec.num_nodes)
+        for (double pm : spec.percent_malicious)
+            for (double ttx : spec.Ttx)
+                for (double tk : spec.Tk)
+                    for (int gt : spec.get_timeout)
+                        for (int tt : spec.total_time)
+                            for (const string& flags : spec.flags)
+                                points.push_back({n, pm, ttx, tk, gt, tt, flags});
+
+    // Without a confidence interval target every point runs `replications` times. With a target the
+    // replications are the first round, and points whose intervals are still too wide get more rounds.
+    int replications = max(1, spec.replications);
+    bool sequential = spec.ci_target > 0;
+    int max_replications = sequential ? max(replications, spec.max_replications) : replications;
+    int workers = spec.threads > 0 ? spec.threads : max(1u, thread::hardware_concurrency());
+    uint64_t baseSeed = spec.seed >= 0 ? spec.seed : random_device{}();
+    cout << "Running " << points.size() << " parameter combinations x " << replications;
+    if (sequential) cout << " to " << max_replications << " replications (95% CI half width target " << spec.ci_target << ")";
+    else cout << " replications";
+    cout << " on " << workers << " threads (base seed " << baseSeed << ")" << endl;
+
+    vector<SimulationContext> configs(points.size());
+    for (int p = 0; p < (int)points.size(); p++) {
+        SimulationContext& config = configs[p];
+        config.num_nodes = points[p].num_nodes;
+        config.malicious_percentage = points[p].percent_malicious;
+        config.meanTransactionTime = points[p].Ttx;
+        config.averageBlockArrivalTime = points[p].Tk;
+        config.GetRequestTimeout = points[p].get_timeout;
+        config.totalExecutionTime = points[p].total_time;
+        istringstream flagStream(points[p].flags);
+        vector<string> flags{istream_iterator<string>(flagStream), istream_iterator<string>()};
+        if (!parseFlags(config, flags)) throw runtime_error("Unknown flag in sweep flags: " + points[p].flags);
+        config.num_threads = 1; // the parallelism comes from running many simulations at once
+    }
+
+    // Job p * max_replications + r is replication r of point p, its seed does not depend on the rounds. Paired
+    // points (the flag combinations of one parameter combination) share the seeds of their replications, so
+    // they see the same topology, mining draws and transaction schedule and differ only through their flags.
+    int group_size = spec.paired ? spec.flags.size() : 1;
+    auto seedOf = [&](int job) { return baseSeed + (job / max_replications / group_size) * max_replications + job % max_replications; };
+    vector<SimulationResult> results(points.size() * max_replications);
+    vector<string> errors(results.size());
+    vector<int> used(points.size(), 0), batch(points.size(), replications), failed(points.size(), 0);
+    vector<RunningStat> ratio1(points.size()), ratio2(points.size()), events(points.size()), wall(points.size());
+    vector<bool> converged(points.size(), !sequential);
+    atomic<int> finished = 0;
+    mutex outputLock;
+    for (int round = 1; any_of(batch.begin(), batch.end(), [](int b) { return b > 0; }); round++) {
+        int round_jobs = 0;
+        WorkStealingPool pool(workers);
+        for (int p = 0; p < (int)points.size(); p++) {
+            for (int r = used[p]; r < used[p] + batch[p]; r++) pool.push(round_jobs++ % workers, p * max_replications + r);
+        }
+        finished = 0;
+        pool.run([&](int job) {
+            SimulationContext config = configs[job / max_replications];
+            config.seed = seedOf(job); // every job gets its own reproducible stream
+            if (config.restoreFile != "") config.forkSeed = seedOf(job); // forks of a checkpoint differ after the restore
+            try {
+                results[job] = spec.antithetic ? runAntitheticPair(config) : runSimulation(config);
+            } catch (const exception& e) {
+                errors[job] = e.what();
+            }
+            lock_guard<mutex> guard(outputLock);
+            cout << "Finished job " << ++finished << "/" << round_jobs << (sequential ? " of round " + to_string(round) : "") << endl;
+        });
+
+        for (int p = 0; p < (int)points.size(); p++) {
+            // Fold the new replications into the running statistics in order, then decide on another round
+            for (int r = used[p]; r < used[p] + batch[p]; r++) {
+                int job = p * max_replications + r;
+                if (!errors[job].empty()) {
+                    failed[p]++;
+                    cerr << "[ERROR] job " << job << ": " << errors[job] << endl;
+                    continue;
+                }
+                ratio1[p].add(results[job].ratio_malicious_total);
+                ratio2[p].add(results[job].ratio_malicious_totalMalicious);
+                events[p].add(results[job].eventsProcessed);
+                wall[p].add(results[job].wallTime);
+            }
+            used[p] += batch[p];
+            batch[p] = 0;
+            if (!sequential || converged[p]) continue;
+            converged[p] = ratio1[p].ci() <= spec.ci_target && ratio2[p].ci() <= spec.ci_target;
+            if (converged[p] || used[p] >= max_replications) continue;
+            int target = max(ratio1[p].runsForHalfWidth(spec.ci_target), ratio2[p].runsForHalfWidth(spec.ci_target));
+            batch[p] = clamp(target - used[p], 1, max_replications - used[p]);
+        }
+        for (int group = 0; group < (int)points.size(); group += group_size) {
+            // Paired points keep the same number of replications, so every replication has its partners
+            int most = 0;
+            for (int p = group; p < group + group_size; p++) most = max(most, used[p] + batch[p]);
+            for (int p = group; p < group + group_size; p++) batch[p] = most - used[p];
+        }
+    }
+
+    // Paired differences against the first flag combination of every parameter combination
+    vector<RunningStat> difference1(points.size()), difference2(points.size());
+    for (int p = 0; spec.paired && p < (int)points.size(); p++) {
+        int baseline = p - p % group_size;
+        if (p == baseline) continue;
+        for (int r = 0; r < used[p]; r++) {
+            int job = p * max_replications + r, baseJob = baseline * max_replications + r;
+            if (!errors[job].empty() || !errors[baseJob].empty()) continue;
+            difference1[p].add(results[job].ratio_malicious_total - results[baseJob].ratio_malicious_total);
+            difference2[p].add(results[job].ratio_malicious_totalMalicious - results[baseJob].ratio_malicious_totalMalicious);
+        }
+    }
+
+    bool json = spec.output.size() >= 5 && spec.output.substr(spec.output.size() - 5) == ".json";
+    ofstream out(spec.output, ios::trunc);
+    if (!out.is_open()) throw runtime_error("Unable to open sweep output: " + spec.output);
+    if (json) out << "[\n";
+    else out << "num_nodes,percent_malicious,Ttx,Tk,get_timeout,total_time,flags,replications,failed,converged,ratio_malicious_total_mean,ratio_malicious_total_ci,ratio_malicious_totalMalicious_mean,ratio_malicious_totalMalicious_ci,events_mean,wall_time_mean,difference_ratio_malicious_total_mean,difference_ratio_malicious_total_ci,difference_ratio_malicious_totalMalicious_mean,difference_ratio_malicious_totalMalicious_ci\n";
+    for (int p = 0; p < (int)points.size(); p++) {
+        const RunningStat &s1 = ratio1[p], &s2 = ratio2[p];
+        const Point& point = points[p];
+        if (json) {
+            out << "    {\"num_nodes\": " << point.num_nodes << ", \"percent_malicious\": " << jsonNumber(point.percent_malicious)
+                << ", \"Ttx\": " << jsonNumber(point.Ttx) << ", \"Tk\": " << jsonNumber(point.Tk) << ", \"get_timeout\": " << point.get_timeout
+                << ", \"total_time\": " << point.total_time << ", \"flags\": " << jsonString(point.flags) << ", \"replications\": " << used[p]
+                << ", \"failed\": " << failed[p] << ", \"converged\": " << (converged[p] ? "true" : "false")
+                << ", \"Malicious Blocks in Chain / Total Blocks in Longest Chain\": {\"mean\": " << jsonNumber(s1.mean()) << ", \"ci95\": " << jsonNumber(s1.ci()) << ", \"n\": " << s1.count << "}"
+                << ", \"Malicious Blocks in Chain / Total Malicious Blocks\": {\"mean\": " << jsonNumber(s2.mean()) << ", \"ci95\": " << jsonNumber(s2.ci()) << ", \"n\": " << s2.count << "}"
+                << ", \"events_mean\": " << jsonNumber(events[p].mean()) << ", \"wall_time_mean\": " << jsonNumber(wall[p].mean());
+            if (difference1[p].count) {
+                out << ", \"paired_difference\": {\"baseline_flags\": " << jsonString(points[p - p % group_size].flags)
+                    << ", \"Malicious Blocks in Chain / Total Blocks in Longest Chain\": {\"mean\": " << jsonNumber(difference1[p].mean()) << ", \"ci95\": " << jsonNumber(difference1[p].ci()) << ", \"n\": " << difference1[p].count << "}"
+                    << ", \"Malicious Blocks in Chain / Total Malicious Blocks\": {\"mean\": " << jsonNumber(difference2[p].mean()) << ", \"ci95\": " << jsonNumber(difference2[p].ci()) << ", \"n\": " << difference2[p].count << "}}";
+            }
+            out << "}" << (p + 1 < (int)points.size() ? ",\n" : "\n");
+        } else {
+            out << point.num_nodes << "," << point.percent_malicious << "," << point.Ttx << "," << point.Tk << "," << point.get_timeout << ","
+                << point.total_time << "," << csvString(point.flags) << "," << used[p] << "," << failed[p] << "," << (converged[p] ? "true" : "false") << ","
+                << s1.mean() << "," << s1.ci() << "," << s2.mean() << "," << s2.ci() << "," << events[p].mean() << "," << wall[p].mean() << ",";
+            if (difference1[p].count) out << difference1[p].mean() << "," << difference1[p].ci() << "," << difference2[p].mean() << "," << difference2[p].ci();
+            else out << ",,,";
+            out << "\n";
+        }
+    }
+    if (json) out << "]\n";
+    cout << "Results saved to " << spec.output << endl;
+    return 0;
+}
@@ -0,0 +1,48 @@
+/* This file contains the in-process simulation driver and the parameter sweep mode */
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "context.h"
+#include "markov.h"
+using namespace std;
+
+// Metrics of one finished simulation
+struct SimulationResult {
+    double ratio_malicious_total = NAN;          // Malicious Blocks in Chain / Total Blocks in Longest Chain
+    double ratio_malicious_totalMalicious = NAN; // Malicious Blocks in Chain / Total Malicious Blocks
+    int numMaliciousBlocks_chain = 0;
+    int numHonestBlocks_chain = 0;
+    int totalMaliciousBlocks = 0;
+    long long eventsProcessed = 0;
+    double wallTime = 0;
+    CalibrationCount calibration; // Input of the Markov engine, see countCalibration
+};
+
+// A grid of parameters, every combination is simulated `replications` times
+struct SweepSpec {
+    vector<int> num_nodes = {100};
+    vector<double> percent_malicious = {50};
+    vector<double> Ttx = {10};
+    vector<double> Tk = {100};
+    vector<int> get_timeout = {20};
+    vector<int> total_time = {17500};
+    vector<string> flags = {""};
+    int replications = 3;       // With a ci_target, the replications of the first round
+    double ci_target = 0;       // Stop a point once both ratios have a 95% CI half width below this (0 disables)
+    int max_replications = 30;  // Upper bound on the replications of a point when ci_target is set
+    bool paired = false;        // The flag combinations of a point share their random numbers, differences to the first one are reported
+    bool antithetic = false;    // Every replication is a pair of runs, the second with mirrored random numbers
+    int threads = 0; // 0 uses all the hardware threads
+    long long seed = -1; // -1 draws a random base seed
+    string output = "sweep_results.json";
+};
+
+bool parseFlags(SimulationContext& ctx, const vector<string>& args);
+SimulationResult runSimulation(const SimulationContext& config, const function<void(SimulationContext&)>& inspect = {});
+SweepSpec parseSweepSpec(const string& path);
+int runSweep(const SweepSpec& spec);
+
+#endif
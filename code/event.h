@@ -5,9 +5,10 @@
 #include "transaction.h"
 #include "block.h"
 #include <variant>
+#include <vector>
 using namespace std;
 
-typedef variant<Transaction, Block, string> EventData; // type safe union
+typedef variant<TxIndex, Block, string, vector<TxIndex>> EventData; // type safe union, transactions are indices of the TransactionTable
 
 // Enum to represent the type of the event. It creates a mapping between the event type and a string.
 enum EventType {
@@ -25,8 +26,56 @@ enum EventType {
     HANDLE_TIMEOUT,
     PRIVATE_MESSAGE_SEND,
     PRIVATE_MESSAGE_RECEIVE,
+    INVENTORY_TRICKLE,            // A peer announces the transactions it learned since the last trickle
+    INVENTORY_SEND,
+    INVENTORY_RECEIVE,
+    GETDATA_SEND,
+    GETDATA_RECEIVE,
+    TRANSACTION_BATCH_SEND,
+    TRANSACTION_BATCH_RECEIVE,
+    BLOCK_TRANSACTIONS_REQUEST_SEND, // A peer asks for the transactions of a compact block it does not know
+    BLOCK_TRANSACTIONS_REQUEST_RECEIVE,
+    BLOCK_TRANSACTIONS_SEND,
+    BLOCK_TRANSACTIONS_RECEIVE,
+    BLOCK_VALIDATION,             // A peer finished the validation of a received block
+    GET_STAGGER,                  // A peer may send the next of its parallel GET requests for a block
+    EVENT_TYPE_COUNT,             // Number of event types, stays last
 };
 
+inline string eventTypeName(EventType type) {
+    /* This function creates a mapping between the type of the event and a string, which can be used for printing */
+    switch (type) {
+        case CREATE_TRANSACTION: return "CREATE_TRANSACTION";
+        case TRANSACTION_SEND: return "TRANSACTION_SEND";
+        case TRANSACTION_RECEIVE: return "TRANSACTION_RECEIVE";
+        case MINING_START: return "MINING_START";
+        case MINING_END: return "MINING_END";
+        case BLOCK_SEND: return "BLOCK_SEND";
+        case BLOCK_RECEIVE: return "BLOCK_RECEIVE";
+        case GET_SEND: return "GET_SEND";
+        case GET_RECEIVE: return "GET_RECEIVE";
+        case HASH_RECEIVE: return "HASH_RECEIVE";
+        case HASH_SEND: return "HASH_SEND";
+        case HANDLE_TIMEOUT: return "HANDLE_TIMEOUT";
+        case PRIVATE_MESSAGE_SEND: return "PRIVATE_MESSAGE_SEND";
+        case PRIVATE_MESSAGE_RECEIVE: return "PRIVATE_MESSAGE_RECEIVE";
+        case INVENTORY_TRICKLE: return "INVENTORY_TRICKLE";
+        case INVENTORY_SEND: return "INVENTORY_SEND";
+        case INVENTORY_RECEIVE: return "INVENTORY_RECEIVE";
+        case GETDATA_SEND: return "GETDATA_SEND";
+        case GETDATA_RECEIVE: return "GETDATA_RECEIVE";
+        case TRANSACTION_BATCH_SEND: return "TRANSACTION_BATCH_SEND";
+        case TRANSACTION_BATCH_RECEIVE: return "TRANSACTION_BATCH_RECEIVE";
+        case BLOCK_TRANSACTIONS_REQUEST_SEND: return "BLOCK_TRANSACTIONS_REQUEST_SEND";
+        case BLOCK_TRANSACTIONS_REQUEST_RECEIVE: return "BLOCK_TRANSACTIONS_REQUEST_RECEIVE";
+        case BLOCK_TRANSACTIONS_SEND: return "BLOCK_TRANSACTIONS_SEND";
+        case BLOCK_TRANSACTIONS_RECEIVE: return "BLOCK_TRANSACTIONS_RECEIVE";
+        case BLOCK_VALIDATION: return "BLOCK_VALIDATION";
+        case GET_STAGGER: return "GET_STAGGER";
+        default: return "UNKNOWN_EVENT";
+    }
+}
+
 struct Event {
     double time;           
     EventType type;        
@@ -34,37 +83,38 @@ struct Event {
     int targetPeer;       
     EventData data;
     bool whether_overlay = false;       
+    long long sequence = 0; // Order of events at the same time, set by the simulator
 
     Event(double time, EventType type, int sourcePeer, int targetPeer, EventData data)
-        : time(time), type(type), sourcePeer(sourcePeer), targetPeer(targetPeer), data(data) {}
+        : time(time), type(type), sourcePeer(sourcePeer), targetPeer(targetPeer), data(move(data)) {}
     
     Event(double time, EventType type, int sourcePeer, int targetPeer, EventData data, bool whether_overlay)
-        : time(time), type(type), sourcePeer(sourcePeer), targetPeer(targetPeer), data(data), whether_overlay(whether_overlay) {}
+        : time(time), type(type), sourcePeer(sourcePeer), targetPeer(targetPeer), data(move(data)), whether_overlay(whether_overlay) {}
 
     bool operator<(const Event& other) const {
         // For sorting the events in the priority queue
-        return time > other.time; 
+        if (time != other.time) return time > other.time; 
+        return sequence > other.sequence;
     }
-    string eventTypeToString() {
-        /* This function creates a mapping between the type of the event and a string, which can be used for printing */
+    int owner() const {
+        // The peer that handles the event, messages are handled by the receiver and everything else by the sender
         switch (type) {
-            case CREATE_TRANSACTION: return "CREATE_TRANSACTION";
-            case TRANSACTION_SEND: return "TRANSACTION_SEND";
-            case TRANSACTION_RECEIVE: return "TRANSACTION_RECEIVE";
-            case MINING_START: return "MINING_START";
-            case MINING_END: return "MINING_END";
-            case BLOCK_SEND: return "BLOCK_SEND";
-            case BLOCK_RECEIVE: return "BLOCK_RECEIVE";
-            case GET_SEND: return "GET_SEND";
-            case GET_RECEIVE: return "GET_RECEIVE";
-            case HASH_RECEIVE: return "HASH_RECEIVE";
-            case HASH_SEND: return "HASH_SEND";
-            case HANDLE_TIMEOUT: return "HANDLE_TIMEOUT";
-            case PRIVATE_MESSAGE_SEND: return "PRIVATE_MESSAGE_SEND";
-            case PRIVATE_MESSAGE_RECEIVE: return "PRIVATE_MESSAGE_RECEIVE";
-            default: return "UNKNOWN_EVENT";
+            case TRANSACTION_RECEIVE:
+            case BLOCK_RECEIVE:
+            case GET_RECEIVE:
+            case HASH_RECEIVE:
+            case PRIVATE_MESSAGE_RECEIVE:
+            case INVENTORY_RECEIVE:
+            case GETDATA_RECEIVE:
+            case TRANSACTION_BATCH_RECEIVE:
+            case BLOCK_TRANSACTIONS_REQUEST_RECEIVE:
+            case BLOCK_TRANSACTIONS_RECEIVE:
+                return targetPeer;
+            default:
+                return sourcePeer;
         }
     }
+    string eventTypeToString() { return eventTypeName(type); }
 
     friend std::ostream& operator<<(std::ostream& os, Event& obj) {
         if (obj.type == CREATE_TRANSACTION) {
@@ -109,6 +159,30 @@ struct Event {
         else if (obj.type == PRIVATE_MESSAGE_RECEIVE) {
             os << "Peer " << obj.targetPeer << " received a private message from Peer " << obj.sourcePeer;
         }
+        else if (obj.type == INVENTORY_TRICKLE) {
+            os << "Peer " << obj.sourcePeer << " announced its new transactions";
+        }
+        else if (obj.type == INVENTORY_SEND || obj.type == INVENTORY_RECEIVE) {
+            os << "Peer " << obj.sourcePeer << " announced " << get<vector<TxIndex>>(obj.data).size() << " transactions to Peer " << obj.targetPeer;
+        }
+        else if (obj.type == GETDATA_SEND || obj.type == GETDATA_RECEIVE) {
+            os << "Peer " << obj.sourcePeer << " requested " << get<vector<TxIndex>>(obj.data).size() << " transactions from Peer " << obj.targetPeer;
+        }
+        else if (obj.type == TRANSACTION_BATCH_SEND || obj.type == TRANSACTION_BATCH_RECEIVE) {
+            os << "Peer " << obj.sourcePeer << " sent " << get<vector<TxIndex>>(obj.data).size() << " transactions to Peer " << obj.targetPeer;
+        }
+        else if (obj.type == BLOCK_TRANSACTIONS_REQUEST_SEND || obj.type == BLOCK_TRANSACTIONS_REQUEST_RECEIVE) {
+            os << "Peer " << obj.sourcePeer << " requested " << get<vector<TxIndex>>(obj.data).size() << " block transactions from Peer " << obj.targetPeer;
+        }
+        else if (obj.type == BLOCK_TRANSACTIONS_SEND || obj.type == BLOCK_TRANSACTIONS_RECEIVE) {
+            os << "Peer " << obj.sourcePeer << " sent " << get<vector<TxIndex>>(obj.data).size() << " block transactions to Peer " << obj.targetPeer;
+        }
+        else if (obj.type == BLOCK_VALIDATION) {
+            os << "Peer " << obj.sourcePeer << " validated block " << get<string>(obj.data);
+        }
+        else if (obj.type == GET_STAGGER) {
+            os << "Peer " << obj.sourcePeer << " may send another GET request for block " << get<string>(obj.data);
+        }
         else {
             os << "Unknown event type.";
         }
@@ -3,10 +3,7 @@
 string sha256(const string& data) 
 {
     unsigned char hash[SHA256_DIGEST_LENGTH]; 
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-    SHA256_Update(&sha256, data.c_str(), data.size());
-    SHA256_Final(hash, &sha256);
+    EVP_Digest(data.data(), data.size(), hash, nullptr, EVP_sha256(), nullptr); // The SHA256_* calls are deprecated since OpenSSL 3.0
 
     stringstream ss;
     for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
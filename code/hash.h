@@ -8,7 +8,7 @@
 
 using namespace std;
 
-#include <openssl/sha.h>
+#include <openssl/evp.h>
 string sha256(const string& data);
 
 #endif
\ No newline at end of file
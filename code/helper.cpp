@@ -1,46 +1,29 @@
 #include "helper.h"
 
-mt19937 gen(random_device{}()); // Mersenne Twister 19937 generator
-
-int current_transaction_id = 0; // Transaction ID counter
-int current_block_id = 0; // Block ID counter
-
-int generateBlockID() {
-    // Return block ID and increment counter
-    return current_block_id++;
-}
-
-double exponentialRandom(double mean) {
+double exponentialRandom(RandomStream& gen, double mean) {
     // Return random number from exponential distribution
-    exponential_distribution<> dist(1.0 / mean);
-    return dist(gen);
+    return gen.nextExponential(mean);
 }
 
-double uniformRandom(double min, double max) {
+double uniformRandom(RandomStream& gen, double min, double max) {
     // Return random number from uniform distribution
-    uniform_real_distribution<> dist(min, max);
-    return dist(gen);
+    return min + (max - min) * gen.nextUniform();
 }
 
-double calculateLatency(bool isSlowI, bool isSlowJ, int messageLength, bool whether_overlay) {
+double calculateLatency(RandomStream& gen, bool isSlowI, bool isSlowJ, int messageLength, bool whether_overlay) {
     // For latency in seconds
     bool isFastI = !isSlowI;
     bool isFastJ = !isSlowJ;
     double cij = isFastI && isFastJ ? FAST_LINK_SPEED : SLOW_LINK_SPEED;
-    double rhoij = uniformRandom(MIN_PROPAGATION_DELAY, MAX_PROPAGATION_DELAY);
-    if (whether_overlay) rhoij = uniformRandom(MIN_OVERLAY_PROPAGATION_DELAY, MAX_OVERLAY_PROPAGATION_DELAY);
+    double rhoij = whether_overlay ? uniformRandom(gen, MIN_OVERLAY_PROPAGATION_DELAY, MAX_OVERLAY_PROPAGATION_DELAY)
+                                   : uniformRandom(gen, MIN_PROPAGATION_DELAY, MAX_PROPAGATION_DELAY);
     double meanQueuingDelay = MEAN_QUEUING_DELAY_FACTOR / cij;
-    double dij = exponentialRandom(meanQueuingDelay);
+    double dij = exponentialRandom(gen, meanQueuingDelay);
     double latency = rhoij + ((double)messageLength / cij) * 1e3 + dij * 1e3; // converting to milliseconds
     return latency / 1e3; 
 }
 
-int generateTransactionID() {
-    // Return transaction ID and increment counter
-    return current_transaction_id++;
-}
-
-vector<int> getSlowNodeSubset(int numNodes, double slowNodePercentage) {
+vector<int> getSlowNodeSubset(RandomStream& gen, int numNodes, double slowNodePercentage) {
     // Return subset of slow nodes
     if (numNodes <= 0) {
         throw invalid_argument("Number of nodes must be positive.");
@@ -142,142 +125,215 @@ void add_peers_to_file(vector<int> malicious_peers) {
     outFile.close();
 }
 
-void generateConnectedGraph() {
-    // Generate connected graph
-    vector<int> peer_ids;
-    for (int i = 0 ; i < num_nodes ; i ++ ) peer_ids.push_back(peers[i]->id);
-    vector<pair<int, int>> edges;
-    int num_peers = peer_ids.size();
-
-    int minPossibleDegree = min(3, num_peers - 1);
-
-    if(num_peers < 2) return; // No edges to add
-    vector<set<int>> adj_list(num_peers);
-    vector<int> shuffled_ids = peer_ids;
-    shuffle(shuffled_ids.begin(), shuffled_ids.end(), gen);
-    for(int i = 1; i < num_peers; i++) {
-        // Adding edges between shuffled peers
-        int peer1 = shuffled_ids[i - 1],
-            peer2 = shuffled_ids[i];
-        adj_list[peer1].insert(peer2);
-        adj_list[peer2].insert(peer1);
-        edges.emplace_back(peer1, peer2);
+FlatGraph::FlatGraph(int num_vertices, int maxDegree) : num_vertices(num_vertices), maxDegree(maxDegree) {
+    degree.assign(num_vertices, 0);
+    adjacency.assign((size_t)num_vertices * maxDegree, -1);
+}
+
+bool FlatGraph::hasEdge(int u, int v) const {
+    // At most maxDegree entries to look at
+    const int* row = &adjacency[(size_t)u * maxDegree];
+    for (int i = 0; i < degree[u]; i++) {
+        if (row[i] == v) return true;
     }
-    for(int i = 0; i < num_peers; i++) {
-        // Adding more edges to make the graph connected and ensuring that each peer has at least 3 neighbours and not more than 6
-        int curr_peer = peer_ids[i];
-        while(adj_list[curr_peer].size() < minPossibleDegree) {
-            int rand_peer = peer_ids[rand() % num_peers];
-            if(rand_peer != curr_peer && adj_list[curr_peer].find(rand_peer) == adj_list[curr_peer].end() && adj_list[rand_peer].size() < 6) {
-                adj_list[curr_peer].insert(rand_peer);
-                adj_list[rand_peer].insert(curr_peer);
-                edges.emplace_back(curr_peer, rand_peer);
+    return false;
+}
+
+void FlatGraph::addEdge(int u, int v) {
+    adjacency[(size_t)u * maxDegree + degree[u]++] = v;
+    adjacency[(size_t)v * maxDegree + degree[v]++] = u;
+    edges.emplace_back(u, v);
+}
+
+void FlatGraph::removeEdge(int u, int v) {
+    // Only used when the graph has to be rewired, so the linear search of the edge list is fine
+    auto removeFrom = [&](int a, int b) {
+        int* row = &adjacency[(size_t)a * maxDegree];
+        for (int i = 0; i < degree[a]; i++) {
+            if (row[i] != b) continue;
+            row[i] = row[--degree[a]];
+            row[degree[a]] = -1;
+            return;
+        }
+    };
+    removeFrom(u, v);
+    removeFrom(v, u);
+    erase_if(edges, [&](const pair<int, int>& e) { return (e.first == u && e.second == v) || (e.first == v && e.second == u); });
+}
+
+FlatGraph buildRandomGraph(int num_vertices, int minDegree, int maxDegree, RandomStream rng) {
+    // Builds a connected random graph on the vertices 0..num_vertices-1 in which every vertex has
+    // between minDegree and maxDegree neighbours. A random path makes the graph connected, then each
+    // vertex below minDegree is joined to random vertices picked from the pool of unsaturated vertices,
+    // or splits an edge between two saturated vertices when the pool has no vertex left for it.
+    FlatGraph graph(num_vertices, maxDegree);
+    if (num_vertices < 2) return graph;
+    vector<int> order(num_vertices);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), rng);
+    for (int i = 1; i < num_vertices; i++) graph.addEdge(order[i - 1], order[i]);
+
+    // Vertices which can still take a neighbour, with their position in the pool for O(1) removal
+    vector<int> open(num_vertices), position(num_vertices);
+    iota(open.begin(), open.end(), 0);
+    iota(position.begin(), position.end(), 0);
+    auto saturate = [&](int v) {
+        if (graph.degree[v] < maxDegree || position[v] < 0) return;
+        int last = open.back();
+        open[position[v]] = last;
+        position[last] = position[v];
+        open.pop_back();
+        position[v] = -1;
+    };
+    for (int i = 0; i < num_vertices; i++) saturate(i);
+
+    constexpr int maxRejections = 32;
+    for (int curr : order) {
+        while (graph.degree[curr] < minDegree) {
+            int chosen = -1;
+            for (int attempt = 0; attempt < maxRejections && chosen == -1; attempt++) {
+                int candidate = open[rng() % open.size()];
+                if (candidate != curr && !graph.hasEdge(curr, candidate)) chosen = candidate;
             }
+            if (chosen == -1) {
+                // Almost every open vertex is already a neighbour, so fall back to a scan of the pool
+                for (int candidate : open) {
+                    if (candidate != curr && !graph.hasEdge(curr, candidate)) { chosen = candidate; break; }
+                }
+            }
+            if (chosen == -1) {
+                // Every vertex which is not a neighbour yet is saturated: split an edge (w, x) of one of them into (curr, w)
+                // and (other, x). other is curr itself when it has room for two more neighbours, and otherwise another open
+                // vertex, which is then a neighbour of curr. The degrees of w and x stay the same and the graph stays connected.
+                int other = curr;
+                if (graph.degree[curr] + 2 > maxDegree) {
+                    other = -1;
+                    for (int candidate : open) {
+                        if (candidate != curr) { other = candidate; break; }
+                    }
+                }
+                bool whether_rewired = false;
+                for (int w = 0; w < num_vertices && other != -1 && !whether_rewired; w++) {
+                    if (w == curr || w == other || graph.hasEdge(curr, w)) continue;
+                    for (int k = 0; k < graph.degree[w]; k++) {
+                        int x = graph.adjacency[(size_t)w * maxDegree + k];
+                        if (x == curr || x == other || graph.hasEdge(other, x)) continue;
+                        graph.removeEdge(w, x);
+                        graph.addEdge(curr, w);
+                        graph.addEdge(other, x);
+                        saturate(curr);
+                        saturate(other);
+                        whether_rewired = true;
+                        break;
+                    }
+                }
+                if (whether_rewired) continue;
+                throw runtime_error("Unable to give vertex " + to_string(curr) + " of the random graph " + to_string(minDegree) + " neighbours with at most " + to_string(maxDegree) + " per vertex");
+            }
+            graph.addEdge(curr, chosen);
+            saturate(curr);
+            saturate(chosen);
         }
     }
-    for (int i = 0 ; i < edges.size() ; i ++ ) {
-        // Updating the neighbours of the peers
-        int peer1 = edges[i].first;
-        int peer2 = edges[i].second;
-        peers[peer1]->neighbours[peer2] = peers[peer2];
-        peers[peer2]->neighbours[peer1] = peers[peer1];
-
-        if(enable_countermeasure) {
-            peers[peer1]->trustScore[peer2] = maxTrustScore;
-            peers[peer2]->trustScore[peer1] = maxTrustScore;
-
-            peers[peer1]->pastAttempts[peer2] = pair<int, int>(1, 1);
-            peers[peer2]->pastAttempts[peer1] = pair<int, int>(1, 1);
-
-            peers[peer1]->banCount[peer2] = 0;
-            peers[peer2]->banCount[peer1] = 0;
-        }   
-    }
-    for (int i = 0 ; i < peers.size() ; i ++ ) peers[i]->setHashingPower(); // Setting the hashing power of the peers
-
-    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-    
-    shuffled_ids.clear();
+    return graph;
+}
 
-    int num_malicious = (malicious_percentage / 100) * num_peers;
+void parallelFor(int count, int threads, const function<void(int, int)>& body) {
+    // Splits [0, count) into contiguous ranges and runs body(begin, end) for each range on its own thread
+    threads = max(1, min(threads, count));
+    if (threads == 1) {
+        body(0, count);
+        return;
+    }
+    vector<thread> workers;
+    int chunk = (count + threads - 1) / threads;
+    for (int begin = 0; begin < count; begin += chunk) {
+        workers.emplace_back(body, begin, min(count, begin + chunk));
+    }
+    for (auto& worker : workers) worker.join();
+}
 
-    minPossibleDegree = min(num_malicious - 1, 3);
-    
-    vector<int> malicious_peers = peer_ids;
-    shuffle(malicious_peers.begin(), malicious_peers.end(), gen);
+void generateConnectedGraph(SimulationContext& ctx) {
+    // Generate the honest network and the overlay network of the malicious peers
+    vector<Peer*>& peers = ctx.peers;
+    int num_peers = ctx.num_nodes;
+    if (num_peers < 1) return;
+
+    int num_malicious = (ctx.malicious_percentage / 100) * num_peers;
+    vector<int> malicious_peers(num_peers);
+    iota(malicious_peers.begin(), malicious_peers.end(), 0);
+    RandomStream maliciousRng(ctx.seed, MALICIOUS_PEERS_STREAM, RNG_TOPOLOGY);
+    shuffle(malicious_peers.begin(), malicious_peers.end(), maliciousRng);
     malicious_peers.resize(num_malicious);
-
-    // Output the selected random peers
     for (auto id : malicious_peers) {
-        peers[id] -> isMalicious = true;
+        peers[id]->isMalicious = true;
     }
-    map<int, set<int>> malicious_adj_list;
-    vector<pair<int, int>> malicious_edges;
 
-    shuffled_ids = malicious_peers;
-    shuffle(shuffled_ids.begin(), shuffled_ids.end(), gen);
-    
-    for(int i = 1; i < num_malicious; i++) {
-        // Adding edges between shuffled peers
-        int peer1 = shuffled_ids[i - 1], peer2 = shuffled_ids[i];
-        malicious_adj_list[peer1].insert(peer2);
-        malicious_adj_list[peer2].insert(peer1);
-        malicious_edges.emplace_back(peer1, peer2);
+    // The two networks are independent, so the overlay is built on a second thread when allowed
+    FlatGraph honest_graph(0, maxNeighbours), overlay_graph(0, maxNeighbours);
+    auto buildHonest = [&]() { honest_graph = buildRandomGraph(num_peers, min(minNeighbours, num_peers - 1), maxNeighbours, RandomStream(ctx.seed, HONEST_NETWORK_STREAM, RNG_TOPOLOGY)); };
+    auto buildOverlay = [&]() { overlay_graph = buildRandomGraph(num_malicious, min(num_malicious - 1, minNeighbours), maxNeighbours, RandomStream(ctx.seed, OVERLAY_NETWORK_STREAM, RNG_TOPOLOGY)); };
+    if (ctx.num_threads > 1) {
+        thread overlayThread(buildOverlay);
+        buildHonest();
+        overlayThread.join();
+    } else {
+        buildHonest();
+        buildOverlay();
     }
-    
-    for(int i = 0; i < num_malicious; i++) {
-        // Adding more edges to make the graph connected and ensuring that each peer has at least 3 neighbours and not more than 6
-        int curr_peer = malicious_peers[i];
-        while(malicious_adj_list[curr_peer].size() < minPossibleDegree) {
-            int rand_peer = malicious_peers[rand() % num_malicious];
-            if(rand_peer != curr_peer && malicious_adj_list[curr_peer].find(rand_peer) == malicious_adj_list[curr_peer].end() && malicious_adj_list[rand_peer].size() < 6) {
-                malicious_adj_list[curr_peer].insert(rand_peer);
-                malicious_adj_list[rand_peer].insert(curr_peer);
-                malicious_edges.emplace_back(curr_peer, rand_peer);
+
+    // Every peer only writes its own maps, so the peers can be filled in parallel
+    vector<int> overlay_index(num_peers, -1);
+    for (int i = 0; i < num_malicious; i++) overlay_index[malicious_peers[i]] = i;
+    parallelFor(num_peers, ctx.num_threads, [&](int begin, int end) {
+        for (int peer1 = begin; peer1 < end; peer1++) {
+            for (int k = 0; k < honest_graph.degree[peer1]; k++) {
+                int peer2 = honest_graph.adjacency[(size_t)peer1 * maxNeighbours + k];
+                peers[peer1]->neighbours[peer2] = peers[peer2];
+                if (ctx.enable_countermeasure) {
+                    peers[peer1]->trustScore[peer2] = maxTrustScore;
+                    peers[peer1]->pastAttempts[peer2] = pair<int, int>(1, 1);
+                    peers[peer1]->banCount[peer2] = 0;
+                }
+            }
+            int local = overlay_index[peer1];
+            if (local != -1) {
+                for (int k = 0; k < overlay_graph.degree[local]; k++) {
+                    int peer2 = malicious_peers[overlay_graph.adjacency[(size_t)local * maxNeighbours + k]];
+                    peers[peer1]->malicious_neighbours[peer2] = peers[peer2];
+                }
             }
+            peers[peer1]->setHashingPower(); // Setting the hashing power of the peers
         }
-    }
-
-    for (int i = 0 ; i < malicious_edges.size() ; i ++ ) {
-        // Updating the neighbours of the peers
-        int peer1 = malicious_edges[i].first;
-        int peer2 = malicious_edges[i].second;
-        peers[peer1]->malicious_neighbours[peer2] = peers[peer2];
-        peers[peer2]->malicious_neighbours[peer1] = peers[peer1];
-    }
+    });
 
-    if(show_network) {
-        add_graph_to_file("normal_network", edges);
+    if(ctx.show_network) {
+        vector<pair<int, int>> malicious_edges;
+        for (auto& [u, v] : overlay_graph.edges) malicious_edges.emplace_back(malicious_peers[u], malicious_peers[v]);
+        add_graph_to_file("normal_network", honest_graph.edges);
         add_peers_to_file(malicious_peers);
         add_graph_to_file("overlay_network", malicious_edges);
         string command = "python3 drawNetwork/draw.py";
-        int ret_code = system(command.c_str());
+        if (system(command.c_str()) != 0) cerr << "[WARNING] " << command << " failed" << endl;
     }
 }
 
-int getBroadCastNumber() 
-{
-    return broadcastnumber++;
-}
-
-int ratio_cal () {
-    auto ringmasterChain = peers[ringMaster]->blockchain;
-    int numMaliciousBlocks_chain = 0;
-    int numHonestBlocks_chain = 0;
-    int totalMaliciousBlocks = 0;
+RatioResult computeRatios(SimulationContext& ctx) {
+    // Count the malicious blocks in the longest chain and in the whole tree of the ringmaster
+    RatioResult result;
+    vector<Peer*>& peers = ctx.peers;
+    auto ringmasterChain = peers[ctx.ringMaster]->blockchain;
     vector<Block> longestChain = ringmasterChain->currentChain();
 
-    for (Block b : longestChain) {
+    for (Block& b : longestChain) {
         if(peers[b.minerID]->isMalicious) 
-            numMaliciousBlocks_chain += 1;
+            result.numMaliciousBlocks_chain += 1;
             
         else 
-            numHonestBlocks_chain += 1;
+            result.numHonestBlocks_chain += 1;
         
     }
 
-    double ratio_malicious_total = (double)numMaliciousBlocks_chain / ((double)numMaliciousBlocks_chain + numHonestBlocks_chain);
-
     string genesisId = genesisHash;
     queue<string> blocks;
     blocks.push(genesisId);
@@ -288,37 +344,42 @@ int ratio_cal () {
 
         auto child_hashes = ringmasterChain->children_block_ids[parent_id];
         for(string child_id: child_hashes) {
-            Block childBlock = ringmasterChain->blocks[child_id];
+            Block& childBlock = ringmasterChain->blocks[child_id];
             if(peers[childBlock.minerID]->isMalicious) {
-                totalMaliciousBlocks += 1;
+                result.totalMaliciousBlocks += 1;
             }
 
             blocks.push(child_id);
         }
     }
 
-    double ratio_malicious_totalMalicious = (double)numMaliciousBlocks_chain / (double)totalMaliciousBlocks;
+    result.ratio_malicious_total = (double)result.numMaliciousBlocks_chain / ((double)result.numMaliciousBlocks_chain + result.numHonestBlocks_chain);
+    result.ratio_malicious_totalMalicious = (double)result.numMaliciousBlocks_chain / (double)result.totalMaliciousBlocks;
+    return result;
+}
 
-    cout<<"Malicious Chain: "<<numMaliciousBlocks_chain<<endl;
-    cout<<"Total Blocks Chain: "<<(numMaliciousBlocks_chain + numHonestBlocks_chain)<<endl;
-    cout<<"Total Malicious: "<<totalMaliciousBlocks<<endl;
-    cout<<"Malicious Blocks in Chain / Total Blocks in Longest Chain: "<<ratio_malicious_total<<endl;
-    cout<<"Malicious Blocks in Chain / Total Malicious Blocks: "<<ratio_malicious_totalMalicious<<endl;
+int ratio_cal (SimulationContext& ctx) {
+    RatioResult result = computeRatios(ctx);
+    cout<<"Malicious Chain: "<<result.numMaliciousBlocks_chain<<endl;
+    cout<<"Total Blocks Chain: "<<(result.numMaliciousBlocks_chain + result.numHonestBlocks_chain)<<endl;
+    cout<<"Total Malicious: "<<result.totalMaliciousBlocks<<endl;
+    cout<<"Malicious Blocks in Chain / Total Blocks in Longest Chain: "<<result.ratio_malicious_total<<endl;
+    cout<<"Malicious Blocks in Chain / Total Malicious Blocks: "<<result.ratio_malicious_totalMalicious<<endl;
     return 1;
 }
 
-void handlePostRunFlags() {
+void handlePostRunFlags(SimulationContext& ctx) {
     // Handle post run flags
 
-    clearLogFile("countermeasure");
-    if(enable_countermeasure) {
-        for(auto peer: peers) {
+    if (ctx.whether_logging) clearLogFile(ctx.countermeasureDirectory);
+    if(ctx.enable_countermeasure && ctx.whether_logging) {
+        for(auto peer: ctx.peers) {
             peer->reportTrust();
         }
     }
 
-    if(whether_ratio) {
-        ratio_cal();
+    if(ctx.whether_ratio && ctx.ringMaster != -1) {
+        ratio_cal(ctx);
     }
 
     // if (whether_branches) {
@@ -334,26 +395,111 @@ void handlePostRunFlags() {
     //     cout << endl;
     // }
 
-    if (whether_blockchain) {
-        blockchain_print();
+    if (ctx.whether_blockchain) {
+        blockchain_print(ctx);
         string command = "python3 plot_blockchain.py";
-        int ret_code = system(command.c_str());
-    }
-
-    for(int i = 0; i < num_nodes; i++) {
-        delete peers[i]; // Delete the peer objects
+        if (system(command.c_str()) != 0) cerr << "[WARNING] " << command << " failed" << endl;
     }
 }
 
-void blockchain_print() {
+void blockchain_print(SimulationContext& ctx) {
+    vector<Peer*>& peers = ctx.peers;
     system(("rm -rf " + BlockChainSaveDirectory).c_str()); // Remove all previous data
     system(("mkdir " + BlockChainSaveDirectory).c_str()); // Making a new directory
-    if (whether_dump_all) {
-        for (int i = 0 ; i < num_nodes ; i ++ ) {
+    if (ctx.whether_dump_all) {
+        for (int i = 0 ; i < ctx.num_nodes ; i ++ ) {
             peers[i]->blockchain->saveBlockChain(BlockChainSaveDirectory + to_string(i) + ".txt");
         }
-    } else if (ringMaster != -1) {
-        peers[ringMaster]->blockchain->saveBlockChain(BlockChainSaveDirectory + "ringmaster.txt");
+    } else if (ctx.ringMaster != -1) {
+        peers[ctx.ringMaster]->blockchain->saveBlockChain(BlockChainSaveDirectory + "ringmaster.txt");
     }
 }
 
+
+
+long getPeakRSS() {
+    // Peak resident set size of this process in kilobytes
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // macOS reports bytes
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+void printRunStats(long long eventsProcessed, double simulatedTime, double simulationWallTime, double postRunWallTime) {
+    // Print the performance counters of the run, these are parsed by benchSim.py
+    double eventsPerSecond = simulationWallTime > 0 ? eventsProcessed / simulationWallTime : 0;
+    double timeRatio = simulationWallTime > 0 ? simulatedTime / simulationWallTime : 0;
+    cout << "Events Processed: " << eventsProcessed << endl;
+    cout << "Simulated Time: " << simulatedTime << endl;
+    cout << "Simulation Wall Time: " << simulationWallTime << endl;
+    cout << "Post Run Wall Time: " << postRunWallTime << endl;
+    cout << "Events Per Second: " << eventsPerSecond << endl;
+    cout << "Simulated Time / Wall Time: " << timeRatio << endl;
+    cout << "Peak RSS (KB): " << getPeakRSS() << endl;
+}
+
+void printCompactBlockStats(SimulationContext& ctx) {
+    // How often the peers could rebuild a compact block from what they already knew
+    long long received = 0, reconstructed = 0, requested = 0;
+    for (Peer* peer : ctx.peers) {
+        received += peer->compactBlocksReceived;
+        reconstructed += peer->compactBlocksReconstructed;
+        requested += peer->blockTransactionsRequested;
+    }
+    cout << "Compact Blocks Received: " << received << endl;
+    cout << "Compact Blocks Rebuilt Without A Round Trip: " << reconstructed << endl;
+    cout << "Block Transactions Requested: " << requested << endl;
+}
+
+void printFetchLatencyStats(SimulationContext& ctx) {
+    // Distribution of the time honest peers waited for a block after its first announcement
+    vector<double> latencies;
+    long long failed = 0;
+    for (Peer* peer : ctx.peers) {
+        if (peer->isMalicious) continue;
+        latencies.insert(latencies.end(), peer->fetchLatencies.begin(), peer->fetchLatencies.end());
+        failed += peer->failedFetches;
+    }
+    cout << "Honest Block Fetches: " << latencies.size() << endl;
+    cout << "Honest Block Fetches Failed: " << failed << endl;
+    if (latencies.empty()) return;
+    sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (double latency : latencies) sum += latency;
+    auto percentile = [&](double p) { return latencies[min(latencies.size() - 1, (size_t)(p * latencies.size()))]; };
+    cout << "Honest Block Fetch Latency Mean: " << sum / latencies.size() << endl;
+    cout << "Honest Block Fetch Latency P50: " << percentile(0.5) << endl;
+    cout << "Honest Block Fetch Latency P90: " << percentile(0.9) << endl;
+    cout << "Honest Block Fetch Latency P99: " << percentile(0.99) << endl;
+    cout << "Honest Block Fetch Latency Max: " << latencies.back() << endl;
+}
+
+void printLinkQueueStats(SimulationContext& ctx) {
+    // How long the messages waited for their link, which grows as the network saturates
+    long long messages = 0;
+    double delay = 0;
+    for (Peer* peer : ctx.peers) {
+        messages += peer->queuedMessages;
+        delay += peer->queueingDelay;
+    }
+    cout << "Queued Messages: " << messages << endl;
+    cout << "Mean Link Queueing Delay: " << (messages > 0 ? delay / messages : 0) << endl;
+}
+
+void writeEdgeTraffic(SimulationContext& ctx, string path) {
+    // One line per directed edge that carried a message, including the post run broadcast
+    ofstream out(path);
+    if (!out) {
+        cerr << "[ERROR] Unable to write traffic file: " << path << endl;
+        return;
+    }
+    out << "source,target,network,messages,bytes\n";
+    for (Peer* peer : ctx.peers) {
+        for (auto& [edge, traffic] : peer->edgeTraffic) {
+            out << peer->id << "," << edge / 2 << "," << (edge % 2 ? "overlay" : "honest") << "," << traffic.first << "," << traffic.second << "\n";
+        }
+    }
+}
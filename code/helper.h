@@ -12,27 +12,18 @@
 #include <fstream>
 #include <string>
 #include "peer.h"
+#include "context.h"
+#include "rng.h"
 #include <filesystem>
+#include <thread>
+#include <functional>
+#include <sys/resource.h>
 using namespace std;
 
-extern int num_nodes; // referring from main.cpp
-
-extern int current_transaction_id;  
-extern mt19937 gen;      
-extern int current_block_id; 
-extern double malicious_percentage; 
-extern int broadcastnumber;
-extern const string BlockChainSaveDirectory;
+extern const string BlockChainSaveDirectory; // referring from constants.cpp
 
 class Peer;  // Forward declaration of the class Peer
-extern vector<Peer*> peers;
-extern bool whether_ratio;
-extern bool whether_longest_chain_height;
-extern bool whether_blockchain;
-extern bool whether_branches;
-extern bool show_network;
-extern bool enable_countermeasure;
-extern bool whether_dump_all;
+struct SimulationContext;
 
 // Some of the important constants to calculate the latency
 constexpr double FAST_LINK_SPEED = 100e6; // in bits per second
@@ -45,19 +36,50 @@ constexpr double MEAN_QUEUING_DELAY_FACTOR = 96e3; // in bits
 constexpr double maxTrustScore = 100;
 constexpr double banThreshold = 20;
 constexpr double maxBan = 5;
+constexpr int minNeighbours = 3; // degree bounds of the honest and the overlay network
+constexpr int maxNeighbours = 6;
+
+// Undirected graph with a bounded degree, stored as one flat array of maxDegree slots per vertex
+struct FlatGraph {
+    FlatGraph(int num_vertices, int maxDegree);
+    int num_vertices;
+    int maxDegree;
+    vector<int> degree;
+    vector<int> adjacency;
+    vector<pair<int, int>> edges;
+    bool hasEdge(int u, int v) const;
+    void addEdge(int u, int v);
+    void removeEdge(int u, int v);
+};
+
+// Block counts of the ringmaster's blockchain, printed with --ratio
+struct RatioResult {
+    int numMaliciousBlocks_chain = 0;
+    int numHonestBlocks_chain = 0;
+    int totalMaliciousBlocks = 0;
+    double ratio_malicious_total = NAN;          // Malicious Blocks in Chain / Total Blocks in Longest Chain
+    double ratio_malicious_totalMalicious = NAN; // Malicious Blocks in Chain / Total Malicious Blocks
+};
 
-int generateTransactionID();
-int generateBlockID();
-vector<int> getSlowNodeSubset(int numNodes, double slowNodePercentage);
-double uniformRandom(double min, double max);
-double exponentialRandom(double mean);
-double calculateLatency(bool isFastI, bool isFastJ, int messageLength, bool whether_overlay = false);
+vector<int> getSlowNodeSubset(RandomStream& gen, int numNodes, double slowNodePercentage);
+double uniformRandom(RandomStream& gen, double min, double max);
+double exponentialRandom(RandomStream& gen, double mean);
+double calculateLatency(RandomStream& gen, bool isFastI, bool isFastJ, int messageLength, bool whether_overlay = false);
 void logToFile(string level, string message, string filePath);
 void clearLogFile(string filePath);
-void generateConnectedGraph();
+void generateConnectedGraph(SimulationContext& ctx);
+FlatGraph buildRandomGraph(int num_vertices, int minDegree, int maxDegree, RandomStream rng);
+void parallelFor(int count, int threads, const function<void(int, int)>& body);
 string sha256(const string& data);
-int getBroadCastNumber();
-void blockchain_print();
-void handlePostRunFlags();
+void blockchain_print(SimulationContext& ctx);
+RatioResult computeRatios(SimulationContext& ctx);
+int ratio_cal(SimulationContext& ctx);
+void handlePostRunFlags(SimulationContext& ctx);
+long getPeakRSS();
+void printRunStats(long long eventsProcessed, double simulatedTime, double simulationWallTime, double postRunWallTime);
+void printCompactBlockStats(SimulationContext& ctx);
+void printFetchLatencyStats(SimulationContext& ctx);
+void printLinkQueueStats(SimulationContext& ctx);
+void writeEdgeTraffic(SimulationContext& ctx, string path);
 
 #endif
\ No newline at end of file
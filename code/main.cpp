@@ -8,94 +8,92 @@
 #include "transaction.h"
 #include "helper.h"
 #include "blockchain.h"
+#include "memory.h"
+#include "topology.h"
+#include "context.h"
+#include "driver.h"
+#include "markov.h"
 
 using namespace std;
 
-int num_nodes;
-double malicious_percentage;
-bool whether_ratio = false;
-bool whether_longest_chain_height = false;
-bool whether_blockchain = false;
-bool whether_branches = false;
-bool show_network = false;
-bool enable_countermeasure = false;
-bool whether_dump_all = false;
-bool whether_eclipse_attack = true;
-bool debug = false;
-
-// Constants
-const double minerReward = 50;
-double averageBlockArrivalTime = 600;
-const int maxTransactionsPerBlock = 999;
-const int TransactionSize = 8000;
-const int hashSize = 512;
-const int broadcastPrivateChainSize = 512;
-const int getSize = 560;
-const int blockSize = 8000000;
-const string genesisHash = "genesis";
-const string BlockChainSaveDirectory = "blockchain_data/";
-const double initial_balance = 0;
-int totalExecutionTime;
-int GetRequestTimeout;
-int broadcastnumber = 0;
-int ringMaster = -1;
-
-vector<Peer*> peers;
-
 int main (int argc, char *argv[]) {
+    if (argc == 3 && string(argv[1]) == "--sweep") {
+        // Run a whole parameter grid inside this process
+        try {
+            return runSweep(parseSweepSpec(argv[2]));
+        } catch (const exception& e) {
+            cerr << "[ERROR] " << e.what() << endl;
+            return 1;
+        }
+    }
     if (argc < 7) {
         // Checking if the number of arguments is correct
         cout << "Usage: " << argv[0] << " <number-of-nodes> <percentage-of-malicious-nodes> <mean-Time-for-transactions> <average-Block-Arrival-Time> <get-Request-Timeout> <time-of-execution> <flags> " << endl;
+        cout << "       " << argv[0] << " --sweep <sweep-specification>" << endl;
         return 1;
     }
-    totalExecutionTime = stoi(argv[6]);
-    GetRequestTimeout = stoi(argv[5]);
-    for (int i = 7 ; i < argc ; i ++ ) {
-        if (string(argv[i]) == "--ratio") {
-            whether_ratio = true;
-        } else if (string(argv[i]) == "--longest-chain-height") {
-            whether_longest_chain_height = true;
-        } else if (string(argv[i]) == "--blockchain") {
-            whether_blockchain = true;
-        } else if (string(argv[i]) == "--branches") {
-            whether_branches = true;
-        } else if (string(argv[i]) == "--show-network") {
-            show_network = true;
-        } else if (string(argv[i]) == "--countermeasure") {
-            enable_countermeasure = true;
-        } else if (string(argv[i]) == "--dump-all") {
-            whether_dump_all = true;
-        } else if (string(argv[i]) == "--no-eclipse") {
-            whether_eclipse_attack = false;
-        } else if (string(argv[i]) == "--debug") {
-            debug = true;
-        }
+    SimulationContext ctx;
+    ctx.totalExecutionTime = stoi(argv[6]);
+    ctx.GetRequestTimeout = stoi(argv[5]);
+    try {
+        parseFlags(ctx, vector<string>(argv + 7, argv + argc));
+    } catch (const exception& e) {
+        cerr << "[ERROR] " << e.what() << endl;
+        return 1;
     }
 
-    clearLogFile("logFiles"); // Clear the previous messages from the log file
-    num_nodes = stoi(argv[1]);
-    malicious_percentage = stod(argv[2]);
-    averageBlockArrivalTime = stod(argv[4]);
-    Simulator simulator(stod(argv[3]));
-    for (int i = 0; i < num_nodes; i++) {
-        Peer* peer = new Peer(&simulator, i);
-        peers.push_back(peer);
+    ctx.num_nodes = stoi(argv[1]);
+    ctx.malicious_percentage = stod(argv[2]);
+    ctx.meanTransactionTime = stod(argv[3]);
+    ctx.averageBlockArrivalTime = stod(argv[4]);
+    if (ctx.engine == "markov") return runMarkovEngine(ctx);
+    if (ctx.engine != "event") {
+        cerr << "[ERROR] Unknown engine " << ctx.engine << ", use event or markov" << endl;
+        return 1;
+    }
+    if (ctx.checkpointAt >= 0 && ctx.checkpointFile == "") {
+        cerr << "[ERROR] --checkpoint-at needs --checkpoint-out <file>" << endl;
+        return 1;
+    }
+    Simulator simulator(ctx);
+    try {
+        if (ctx.restoreFile != "") simulator.restoreCheckpoint(ctx.restoreFile);
+        else simulator.setup();
+    } catch (const exception& e) {
+        cerr << "[ERROR] " << e.what() << endl;
+        return 1;
+    }
+    int num_malicious = 0;
+    for (Peer* peer : simulator.ctx.peers) num_malicious += peer->isMalicious;
+    cout << "Ringmaster is " << simulator.ctx.ringMaster << "." << endl;
+    cout << "There are " << num_malicious << " malicious peers." << endl;
+    if (ctx.num_observers >= 0) {
+        cout << "There are " << max(0, simulator.ctx.num_nodes - num_malicious - ctx.num_observers) << " relay only peers." << endl;
     }
-    generateConnectedGraph();
-    vector<int> malicious_nodes;
-    for (int i = 0 ; i < num_nodes ; i ++){
-        if (peers[i]->isMalicious) malicious_nodes.push_back(i);
+    auto simulationStart = chrono::steady_clock::now();
+    try {
+        simulator.run();
+    } catch (const exception& e) {
+        cerr << "[ERROR] " << e.what() << endl;
+        return 2;
     }
-    if (malicious_nodes.size()) 
-    {
-        // Selecting the ring master and giving it the hash power of all malicious nodes
-        int ringMasterIndex =  uniformRandom(0, malicious_nodes.size() - 1);
-        ringMaster = malicious_nodes[ringMasterIndex];
-        peers[ringMaster]->hashingPower = ((double)malicious_nodes.size())/num_nodes;
+    auto simulationEnd = chrono::steady_clock::now();
+    MemoryUsage finalMemoryUsage;
+    if (ctx.whether_stats) finalMemoryUsage = simulator.sampleMemory();
+    handlePostRunFlags(simulator.ctx);
+    if (ctx.trafficEdgesFile != "") writeEdgeTraffic(simulator.ctx, ctx.trafficEdgesFile);
+    auto postRunEnd = chrono::steady_clock::now();
+    if (ctx.whether_stats) {
+        // Wall clock split between the event loop and the post run phase
+        double simulationWallTime = chrono::duration<double>(simulationEnd - simulationStart).count();
+        double postRunWallTime = chrono::duration<double>(postRunEnd - simulationEnd).count();
+        printRunStats(simulator.eventsProcessed, simulator.getCurrentTime(), simulationWallTime, postRunWallTime);
+        printMemoryUsage(finalMemoryUsage, "Final");
+        printMemoryUsage(simulator.peakMemoryUsage, "Peak");
+        if (ctx.blockRelay == COMPACT_BLOCK_RELAY) printCompactBlockStats(simulator.ctx);
+        printFetchLatencyStats(simulator.ctx);
+        if (ctx.linkModel != INDEPENDENT_LINKS) printLinkQueueStats(simulator.ctx);
+        printTraffic(simulator.countTraffic());
     }
-    cout << "Ringmaster is " << ringMaster << "." << endl;
-    cout << "There are " << malicious_nodes.size() << " malicious peers." << endl;
-    simulator.run();
-    handlePostRunFlags();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "markov.h"
+#include "driver.h"
+#include <mutex>
+
+CalibrationCount countCalibration(SimulationContext& ctx) {
+    // Walk the block tree of the ringmaster. A parent with an honest and a malicious child is a race, and the
+    // first honest block mined on top of either child picks the winner, as long as the malicious child had no
+    // descendant of the ringmaster yet (otherwise the branches were not of equal length). A parent with
+    // several honest children and no malicious one is a fork between honest blocks, of which one survives.
+    CalibrationCount count;
+    if (ctx.ringMaster == -1) return count;
+    Blockchain* chain = ctx.peers[ctx.ringMaster]->blockchain;
+    auto isMalicious = [&](const string& hash) { return ctx.peers[chain->blocks[hash].minerID]->isMalicious; };
+    for (auto& [parent, children] : chain->children_block_ids) {
+        int honestChildren = 0;
+        bool maliciousChild = false;
+        for (const string& child : children) {
+            if (isMalicious(child)) maliciousChild = true;
+            else honestChildren++;
+        }
+        count.honestBlocks += honestChildren;
+        if (!maliciousChild && honestChildren > 1) count.honestForked += honestChildren - 1;
+        if (!honestChildren || !maliciousChild) continue;
+        double first = numeric_limits<double>::infinity();
+        bool towardsPool = false;
+        for (const string& child : children) {
+            for (const string& grandchild : chain->children_block_ids[child]) {
+                if (isMalicious(grandchild) || chain->block_to_timestamp[grandchild] >= first) continue;
+                first = chain->block_to_timestamp[grandchild];
+                towardsPool = isMalicious(child);
+            }
+        }
+        if (first == numeric_limits<double>::infinity()) continue;
+        bool equalLength = true;
+        for (const string& child : children) {
+            if (!isMalicious(child)) continue;
+            for (const string& grandchild : chain->children_block_ids[child]) {
+                if (isMalicious(grandchild) && chain->block_to_timestamp[grandchild] < first) equalLength = false;
+            }
+        }
+        if (!equalLength) continue;
+        count.races++;
+        count.towardsPool += towardsPool;
+    }
+    return count;
+}
+
+double closedFormRevenue(double alpha, double gamma) {
+    // Relative revenue of a selfish pool with hash power alpha (Eyal and Sirer, "Majority is not enough", 2014)
+    double numerator = alpha * pow(1 - alpha, 2) * (4 * alpha + gamma * (1 - 2 * alpha)) - pow(alpha, 3);
+    double denominator = 1 - alpha * (1 + (2 - alpha) * alpha);
+    return numerator / denominator;
+}
+
+RatioResult markovRatios(double alpha, double gamma, double expectedBlocks, int runs, uint64_t seed) {
+    // Monte Carlo of the selfish mining state machine. Every run mines a Poisson number of blocks with the
+    // given mean, publishes the private chain at the end like the ringmaster does, and the ratios are
+    // averaged over the runs in the same way as the scripts average the runs of the full simulator.
+    RatioResult average;
+    double sumTotal = 0, sumMalicious = 0;
+    int countTotal = 0, countMalicious = 0;
+    for (int run = 0; run < runs; run++) {
+        RandomStream rng(seed, run, RNG_MARKOV);
+        // Number of blocks by inversion of the Poisson distribution, one exponential gap at a time
+        int blocks = 0;
+        for (double elapsed = rng.nextExponential(1.0); elapsed < expectedBlocks; elapsed += rng.nextExponential(1.0)) blocks++;
+        int lead = 0;            // Private blocks of the pool not yet published
+        bool race = false;       // The pool published a block of the same height as the last honest block
+        int poolInChain = 0, honestInChain = 0, poolMined = 0;
+        for (int block = 0; block < blocks; block++) {
+            if (rng.nextUniform() < alpha) {
+                poolMined++;
+                if (race) {
+                    poolInChain += 2; // The pool extends its own branch and wins the race
+                    race = false;
+                } else {
+                    lead++;
+                }
+            } else if (race) {
+                if (rng.nextUniform() < gamma) {
+                    poolInChain++; // The honest block extends the branch of the pool
+                    honestInChain++;
+                } else {
+                    honestInChain += 2;
+                }
+                race = false;
+            } else if (lead == 0) {
+                honestInChain++;
+            } else if (lead == 1) {
+                lead = 0; // The pool publishes its block and a race begins
+                race = true;
+            } else if (lead == 2) {
+                poolInChain += 2; // The pool publishes both blocks and orphans the honest one
+                lead = 0;
+            } else {
+                poolInChain++; // The pool reveals one more block and stays ahead
+                lead--;
+            }
+        }
+        poolInChain += lead + race; // The private chain is broadcast at the end of the run
+        average.numMaliciousBlocks_chain += poolInChain;
+        average.numHonestBlocks_chain += honestInChain;
+        average.totalMaliciousBlocks += poolMined;
+        if (poolInChain + honestInChain > 0) {
+            sumTotal += (double)poolInChain / (poolInChain + honestInChain);
+            countTotal++;
+        }
+        if (poolMined > 0) {
+            sumMalicious += (double)poolInChain / poolMined;
+            countMalicious++;
+        }
+    }
+    if (countTotal) average.ratio_malicious_total = sumTotal / countTotal;
+    if (countMalicious) average.ratio_malicious_totalMalicious = sumMalicious / countMalicious;
+    return average;
+}
+
+int runMarkovEngine(SimulationContext& ctx) {
+    // The ringmaster holds the hash power of all the malicious peers. Gamma comes from --gamma or from short
+    // calibration runs of the full engine with the same parameters, which also measure how much honest hash
+    // power is lost to forks between honest blocks. That loss raises the effective share of the ringmaster.
+    int num_malicious = (ctx.malicious_percentage / 100) * ctx.num_nodes;
+    double alpha = ctx.num_nodes > 0 ? (double)num_malicious / ctx.num_nodes : 0;
+    double gamma = ctx.markovGamma;
+    if (gamma < 0) {
+        CalibrationCount ties;
+        mutex tiesLock;
+        parallelFor(ctx.calibrationRuns, ctx.num_threads, [&](int begin, int end) {
+            for (int run = begin; run < end; run++) {
+                SimulationContext config = ctx;
+                config.totalExecutionTime = min(ctx.totalExecutionTime, ctx.calibrationTime);
+                config.seed = ctx.seed + run;
+                config.num_threads = 1;
+                SimulationResult result = runSimulation(config);
+                lock_guard<mutex> guard(tiesLock);
+                ties.races += result.calibration.races;
+                ties.towardsPool += result.calibration.towardsPool;
+                ties.honestBlocks += result.calibration.honestBlocks;
+                ties.honestForked += result.calibration.honestForked;
+            }
+        });
+        double honestLoss = ties.honestBlocks ? (double)ties.honestForked / ties.honestBlocks : 0;
+        cout << "Calibration Races: " << ties.races << endl;
+        if (ties.races >= minCalibrationRaces) {
+            // Share of the races won by the pool, with the Wilson score interval which stays meaningful near 0 and 1
+            gamma = (double)ties.towardsPool / ties.races;
+            double z = 1.96, n = ties.races;
+            double center = (gamma + z * z / (2 * n)) / (1 + z * z / n);
+            double halfWidth = z / (1 + z * z / n) * sqrt(gamma * (1 - gamma) / n + z * z / (4 * n * n));
+            cout << "Calibration Gamma CI95: [" << center - halfWidth << ", " << center + halfWidth << "]" << endl;
+        } else {
+            gamma = 0.5;
+            cerr << "[WARNING] Only " << ties.races << " races in the calibration runs (at least " << minCalibrationRaces
+                 << " are needed), using gamma = 0.5. Raise --calibration-runs or --calibration-time, or give --gamma" << endl;
+        }
+        cout << "Calibration Honest Fork Loss: " << honestLoss << endl;
+        alpha = alpha / (alpha + (1 - alpha) * (1 - honestLoss));
+    }
+    cout << "Hashing Power of the Ringmaster: " << alpha << endl;
+    cout << "Gamma: " << gamma << endl;
+    cout << "Closed Form Revenue: " << closedFormRevenue(alpha, gamma) << endl;
+    RatioResult result = markovRatios(alpha, gamma, ctx.totalExecutionTime / ctx.averageBlockArrivalTime, ctx.markovRuns, ctx.seed);
+    cout << "Malicious Chain: " << (double)result.numMaliciousBlocks_chain / ctx.markovRuns << endl;
+    cout << "Total Blocks Chain: " << (double)(result.numMaliciousBlocks_chain + result.numHonestBlocks_chain) / ctx.markovRuns << endl;
+    cout << "Total Malicious: " << (double)result.totalMaliciousBlocks / ctx.markovRuns << endl;
+    cout << "Malicious Blocks in Chain / Total Blocks in Longest Chain: " << result.ratio_malicious_total << endl;
+    cout << "Malicious Blocks in Chain / Total Malicious Blocks: " << result.ratio_malicious_totalMalicious << endl;
+    return 0;
+}
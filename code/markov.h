@@ -0,0 +1,26 @@
+/* This file contains the Markov chain engine, a fast estimate of the selfish mining ratios */
+#ifndef MARKOV_H
+#define MARKOV_H
+
+#include "context.h"
+#include "helper.h"
+using namespace std;
+
+// What the Markov engine learns from the block tree of the ringmaster after a full run: the races between a
+// block of the ringmaster and an honest block at the same height (and how many of them the next honest block
+// settled in favour of the ringmaster), and the honest blocks lost to forks between honest blocks
+struct CalibrationCount {
+    int races = 0;
+    int towardsPool = 0;
+    int honestBlocks = 0;
+    int honestForked = 0;
+};
+
+constexpr int minCalibrationRaces = 30; // Below this many races the calibrated gamma is not used
+
+CalibrationCount countCalibration(SimulationContext& ctx);
+double closedFormRevenue(double alpha, double gamma);
+RatioResult markovRatios(double alpha, double gamma, double expectedBlocks, int runs, uint64_t seed);
+int runMarkovEngine(SimulationContext& ctx);
+
+#endif
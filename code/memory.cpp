@@ -0,0 +1,103 @@
+#include "memory.h"
+#include "peer.h"
+#include "blockchain.h"
+#include "context.h"
+#include <unistd.h>
+
+// Every node of a map/set carries the colour and three pointers on top of the value
+constexpr long long treeNodeOverhead = 32;
+// A deque allocates its map and one chunk as soon as it is created
+constexpr long long emptyDequeBytes = 64 + 512;
+
+static long long stringHeapBytes(const string& s) {
+    // Strings shorter than the small string buffer do not allocate
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+long long estimateBlockBytes(const Block& block) {
+    // Heap memory owned by a block, excluding the block object itself
+    // The transactions are a span of the transaction table, counted once for the whole simulation
+    return stringHeapBytes(block.hashBlockHeader) + stringHeapBytes(block.parentHash);
+}
+
+long long estimateEventBytes(const Event& event) {
+    long long bytes = sizeof(Event) + sizeof(void*); // the event and its slot in the heap
+    if (holds_alternative<Block>(event.data)) bytes += estimateBlockBytes(get<Block>(event.data));
+    else if (holds_alternative<string>(event.data)) bytes += stringHeapBytes(get<string>(event.data));
+    else if (holds_alternative<vector<TxIndex>>(event.data)) bytes += get<vector<TxIndex>>(event.data).capacity() * sizeof(TxIndex);
+    return bytes;
+}
+
+static long long estimateBlockchainBytes(const Blockchain* blockchain) {
+    long long bytes = sizeof(Blockchain);
+    long long stringNode = treeNodeOverhead + sizeof(string);
+    for (auto& [hash, block] : blockchain->blocks) bytes += stringNode + sizeof(Block) + stringHeapBytes(hash) + estimateBlockBytes(block);
+    for (auto& [hash, parent] : blockchain->parent_block_id) bytes += stringNode + sizeof(string) + stringHeapBytes(hash) + stringHeapBytes(parent);
+    for (auto& [hash, children] : blockchain->children_block_ids) {
+        bytes += stringNode + sizeof(vector<string>) + stringHeapBytes(hash) + children.capacity() * sizeof(string);
+        for (auto& child : children) bytes += stringHeapBytes(child);
+    }
+    for (auto& hash : blockchain->leafBlocks) bytes += stringNode + stringHeapBytes(hash);
+    for (auto& hash : blockchain->children_without_parent) bytes += stringNode + stringHeapBytes(hash);
+    for (auto& [hash, timestamp] : blockchain->block_to_timestamp) bytes += stringNode + sizeof(double) + stringHeapBytes(hash);
+    for (auto& [hash, announcers] : blockchain->hash_to_queue) bytes += stringNode + sizeof(queue<int>) + emptyDequeBytes + stringHeapBytes(hash);
+    for (auto& [hash, timeout] : blockchain->hash_to_timeout) bytes += stringNode + sizeof(int) + stringHeapBytes(hash);
+    for (auto& [hash, sent] : blockchain->whether_sent_to_honest) bytes += stringNode + sizeof(bool) + stringHeapBytes(hash);
+    for (auto& [hash, block] : blockchain->relayCache) bytes += stringNode + sizeof(Block) + stringHeapBytes(hash) + estimateBlockBytes(block);
+    return bytes;
+}
+
+MemoryUsage sampleMemoryUsage(SimulationContext& ctx, double time, long long eventQueueBytes) {
+    // Walk over all the peers and add up the estimated size of their data structures
+    MemoryUsage usage;
+    usage.time = time;
+    usage.eventQueueBytes = eventQueueBytes;
+    usage.currentRSSKB = getCurrentRSS();
+    long long intNode = treeNodeOverhead + sizeof(int);
+    usage.bookkeepingBytes = ctx.peers.capacity() * sizeof(Peer*) + ctx.honestLinks.bytes() + ctx.overlayLinks.bytes();
+    usage.mempoolBytes = ctx.transactions->memoryBytes() + ctx.balances->memoryBytes();
+    for (Peer* peer : ctx.peers) {
+        usage.blockchainBytes += estimateBlockchainBytes(peer->blockchain);
+        usage.mempoolBytes += peer->mempool.memoryBytes();
+        usage.mempoolBytes += peer->transactionRelayBytes();
+        usage.bookkeepingBytes += sizeof(Peer);
+        usage.logBytes += peer->logBytesWritten;
+        usage.bookkeepingBytes += (peer->neighbours.size() + peer->malicious_neighbours.size()) * (intNode + sizeof(Peer*));
+        usage.bookkeepingBytes += peer->trustScore.size() * (intNode + sizeof(double));
+        usage.bookkeepingBytes += peer->banCount.size() * (intNode + sizeof(int));
+        usage.bookkeepingBytes += peer->pastAttempts.size() * (intNode + sizeof(pair<int, int>));
+        usage.bookkeepingBytes += peer->allBroadcastIDs.size() * intNode;
+        for (auto& [hash, fetch] : peer->blockFetches) usage.bookkeepingBytes += treeNodeOverhead + sizeof(string) + sizeof(BlockFetch) + stringHeapBytes(hash);
+        usage.bookkeepingBytes += peer->fetchLatencies.capacity() * sizeof(double);
+        usage.bookkeepingBytes += peer->edgeQueues.size() * (intNode + sizeof(LinkQueue));
+        usage.bookkeepingBytes += peer->edgeTraffic.size() * (intNode + sizeof(pair<long long, long long>));
+    }
+    return usage;
+}
+
+void printMemoryUsage(const MemoryUsage& usage, string title) {
+    // Print the breakdown in kilobytes
+    cout << title << " Memory Sample Time: " << usage.time << endl;
+    cout << title << " Memory Blockchain (KB): " << usage.blockchainBytes / 1024 << endl;
+    cout << title << " Memory Mempool (KB): " << usage.mempoolBytes / 1024 << endl;
+    cout << title << " Memory Event Queue (KB): " << usage.eventQueueBytes / 1024 << endl;
+    cout << title << " Memory Bookkeeping (KB): " << usage.bookkeepingBytes / 1024 << endl;
+    cout << title << " Memory Logs Written (KB): " << usage.logBytes / 1024 << endl;
+    cout << title << " Memory Estimated Total (KB): " << usage.total() / 1024 << endl;
+    cout << title << " Memory RSS (KB): " << usage.currentRSSKB << endl;
+}
+
+bool memoryBudgetExceeded(SimulationContext& ctx, const MemoryUsage& usage) {
+    // Compare the larger of the estimate and the resident set size against the budget
+    if (ctx.memoryBudgetMB <= 0) return false;
+    long long used = max(usage.total(), (long long)usage.currentRSSKB * 1024);
+    return used > ctx.memoryBudgetMB * 1024 * 1024;
+}
+
+long getCurrentRSS() {
+    // Current resident set size in kilobytes, falls back to the peak where /proc is not available
+    ifstream statm("/proc/self/statm");
+    long pages, residentPages;
+    if (statm >> pages >> residentPages) return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+    return getPeakRSS();
+}
@@ -0,0 +1,31 @@
+/* This file contains the per subsystem memory accounting */
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <string>
+#include "block.h"
+#include "event.h"
+using namespace std;
+
+struct SimulationContext;
+
+// Estimated number of bytes held by each subsystem at a point of simulated time
+struct MemoryUsage {
+    double time = 0;
+    long long blockchainBytes = 0;  // Blockchain maps of all the peers
+    long long mempoolBytes = 0;     // Mempools and seen transactions of all the peers, the transaction table
+    long long eventQueueBytes = 0;  // Pending events of the simulator
+    long long bookkeepingBytes = 0; // Neighbour, countermeasure and broadcast maps of the peers
+    long long logBytes = 0;         // Bytes written to the log files
+    long currentRSSKB = 0;          // Resident set size reported by the operating system
+    long long total() const { return blockchainBytes + mempoolBytes + eventQueueBytes + bookkeepingBytes; }
+};
+
+long long estimateBlockBytes(const Block& block);
+long long estimateEventBytes(const Event& event);
+MemoryUsage sampleMemoryUsage(SimulationContext& ctx, double time, long long eventQueueBytes);
+void printMemoryUsage(const MemoryUsage& usage, string title);
+bool memoryBudgetExceeded(SimulationContext& ctx, const MemoryUsage& usage);
+long getCurrentRSS();
+
+#endif
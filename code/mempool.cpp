@@ -0,0 +1,205 @@
+#include "mempool.h"
+#include <algorithm>
+
+// Every node of a map/set carries the colour and three pointers on top of the value
+constexpr long long mempoolNodeOverhead = 32;
+
+Balances::Balances(int num_peers) {
+    // Every chunk of the genesis balances is the same one
+    Chunk initial;
+    initial.fill(initial_balance);
+    chunks.assign((num_peers + balanceChunkSize - 1) / balanceChunkSize, make_shared<Chunk>(initial));
+}
+
+shared_ptr<const Balances> Balances::after(const Block& block, const TransactionTable& table) const {
+    // Apply the transactions and the reward of the block in their order, copying a chunk on its first change
+    auto next = make_shared<Balances>(*this);
+    auto change = [&](int peer, double amount) {
+        shared_ptr<Chunk>& chunk = next->chunks[peer / balanceChunkSize];
+        if (chunk == chunks[peer / balanceChunkSize]) chunk = make_shared<Chunk>(*chunk);
+        (*chunk)[peer % balanceChunkSize] += amount;
+    };
+    for (TxIndex txn : table.block(block.transactions)) {
+        change(table.sender(txn), -table.amount(txn));
+        change(table.receiver(txn), table.amount(txn));
+    }
+    if (block.minerID >= 0) change(block.minerID, minerReward);
+    return next;
+}
+
+shared_ptr<const Balances> BalanceCache::genesis(int num_peers) {
+    lock_guard<mutex> guard(lock);
+    if (!genesisVersion) genesisVersion = make_shared<const Balances>(num_peers);
+    return genesisVersion;
+}
+
+shared_ptr<const Balances> BalanceCache::find(const string& hash) {
+    lock_guard<mutex> guard(lock);
+    if (hash == genesisHash) return genesisVersion;
+    auto version = versions.find(hash);
+    return version == versions.end() ? nullptr : version->second.lock();
+}
+
+shared_ptr<const Balances> BalanceCache::child(const shared_ptr<const Balances>& parent, const Block& block) {
+    if (auto version = find(block.getBlockHeaderHash())) return version;
+    shared_ptr<const Balances> built = parent->after(block, table);
+    lock_guard<mutex> guard(lock);
+    weak_ptr<const Balances>& entry = versions[block.getBlockHeaderHash()];
+    if (auto version = entry.lock()) return version; // Another partition built the same version meanwhile
+    entry = built;
+    recent.push_back(built);
+    if ((int)recent.size() > recentBalanceVersions) recent.pop_front();
+    if (versions.size() >= pruneAt) {
+        erase_if(versions, [](auto& version) { return version.second.expired(); });
+        pruneAt = max<size_t>(1024, 2 * versions.size());
+    }
+    return built;
+}
+
+shared_ptr<const Balances> BalanceCache::at(const string& hash, const map<string, Block>& blocks) {
+    // Go up the chain to the closest block with a known version and build the versions back down from there
+    vector<const Block*> path;
+    shared_ptr<const Balances> version;
+    for (string current = hash; !(version = find(current)); current = path.back()->parentHash) path.push_back(&blocks.at(current));
+    for (auto block = path.rbegin(); block != path.rend(); block++) version = child(version, **block);
+    return version;
+}
+
+long long BalanceCache::memoryBytes() {
+    // Every live version once, and every chunk once however many versions share it
+    lock_guard<mutex> guard(lock);
+    set<const Balances::Chunk*> chunks;
+    long long bytes = sizeof(BalanceCache) + recent.size() * sizeof(recent[0]);
+    auto count = [&](const Balances& version) {
+        bytes += sizeof(Balances) + version.chunks.capacity() * sizeof(version.chunks[0]);
+        for (auto& chunk : version.chunks) {
+            if (chunks.insert(chunk.get()).second) bytes += sizeof(Balances::Chunk) + mempoolNodeOverhead;
+        }
+    };
+    if (genesisVersion) count(*genesisVersion);
+    for (auto& [hash, entry] : versions) {
+        bytes += mempoolNodeOverhead + sizeof(string) + sizeof(entry) + (hash.capacity() > 15 ? hash.capacity() + 1 : 0);
+        if (auto version = entry.lock()) count(*version);
+    }
+    return bytes;
+}
+
+Mempool::Mempool(SimulationContext& ctx) : ctx(ctx), tip(ctx.balances->genesis(ctx.num_nodes)), tipHash(genesisHash) {}
+
+bool Mempool::contains(TxIndex txn) const {
+    return pending.contains(txn);
+}
+
+void Mempool::markDirty(int sender) {
+    dirtySenders.insert(sender);
+}
+
+void Mempool::add(TxIndex txn) {
+    if (!pending.insert(txn)) return;
+    int sender = ctx.transactions->sender(txn);
+    vector<TxIndex>& queue = bySender[sender];
+    queue.insert(upper_bound(queue.begin(), queue.end(), txn), txn); // New transactions go to the end
+    markDirty(sender);
+}
+
+void Mempool::remove(TxIndex txn) {
+    if (!pending.erase(txn)) return;
+    int sender = ctx.transactions->sender(txn);
+    auto queue = bySender.find(sender);
+    queue->second.erase(lower_bound(queue->second.begin(), queue->second.end(), txn));
+    if (queue->second.empty()) bySender.erase(queue);
+    markDirty(sender);
+}
+
+void Mempool::markBlock(const Block& block) {
+    // The balances moved for the peers of the block, which only matters to the ones with pending transactions
+    TransactionTable& table = *ctx.transactions;
+    for (TxIndex txn : table.block(block.transactions)) {
+        if (bySender.contains(table.sender(txn))) markDirty(table.sender(txn));
+        if (bySender.contains(table.receiver(txn))) markDirty(table.receiver(txn));
+    }
+    if (bySender.contains(block.minerID)) markDirty(block.minerID);
+}
+
+void Mempool::connectBlock(const Block& block) {
+    for (TxIndex txn : ctx.transactions->block(block.transactions)) remove(txn);
+    tip = ctx.balances->child(tip, block);
+    tipHash = block.getBlockHeaderHash();
+    markBlock(block);
+}
+
+void Mempool::disconnectBlock(const Block& block, const map<string, Block>& blocks) {
+    for (TxIndex txn : ctx.transactions->block(block.transactions)) add(txn);
+    tip = ctx.balances->at(block.parentHash, blocks);
+    tipHash = block.parentHash;
+    markBlock(block);
+}
+
+void Mempool::refreshSender(int sender) {
+    // Pick the transactions of the sender, newest first, as long as its balance covers them
+    auto chosen = selectedBySender.find(sender);
+    if (chosen != selectedBySender.end()) {
+        for (int txnID : chosen->second) selected.erase(txnID);
+        selectedBySender.erase(chosen);
+    }
+    auto queue = bySender.find(sender);
+    if (queue == bySender.end()) return;
+    vector<int> ids;
+    double remaining = (*tip)[sender];
+    for (auto txn = queue->second.rbegin(); txn != queue->second.rend(); txn++) {
+        double amount = ctx.transactions->amount(*txn);
+        if (remaining < amount) continue;
+        remaining -= amount;
+        int txnID = ctx.transactions->id(*txn);
+        ids.push_back(txnID);
+        selected.emplace(txnID, *txn);
+    }
+    if (!ids.empty()) selectedBySender[sender] = move(ids);
+}
+
+vector<TxIndex> Mempool::blockTemplate() {
+    // The newest transactions that fit the balances, which is what a greedy pass over the whole pool would pick
+    for (int sender : dirtySenders) refreshSender(sender);
+    dirtySenders.clear();
+    vector<TxIndex> transactions;
+    transactions.reserve(min<size_t>(selected.size(), maxTransactionsPerBlock));
+    for (auto& [txnID, txn] : selected) {
+        if ((int)transactions.size() >= maxTransactionsPerBlock) break;
+        transactions.push_back(txn);
+    }
+    return transactions;
+}
+
+long long Mempool::memoryBytes() const {
+    // The balances are shared with the other mempools and counted once by the BalanceCache
+    long long bytes = sizeof(Mempool) + pending.memoryBytes();
+    bytes += tipHash.capacity() > 15 ? tipHash.capacity() + 1 : 0;
+    for (auto& [sender, queue] : bySender) bytes += mempoolNodeOverhead + sizeof(sender) + sizeof(queue) + queue.capacity() * sizeof(TxIndex);
+    for (auto& [sender, ids] : selectedBySender) bytes += mempoolNodeOverhead + sizeof(sender) + sizeof(ids) + ids.capacity() * sizeof(int);
+    bytes += selected.size() * (mempoolNodeOverhead + sizeof(int) + sizeof(TxIndex));
+    bytes += dirtySenders.size() * (mempoolNodeOverhead + sizeof(int));
+    return bytes;
+}
+
+void Mempool::saveState(CheckpointWriter& out) {
+    // The balances, the queues and the template are rebuilt from the tip and the pending set after a restore
+    out.write(tipHash);
+    pending.saveState(out);
+}
+
+void Mempool::loadState(CheckpointReader& in) {
+    // The transaction table of the simulation is restored before the peers
+    in.read(tipHash);
+    TransactionSet restored;
+    restored.loadState(in);
+    pending = TransactionSet();
+    bySender.clear();
+    selectedBySender.clear();
+    selected.clear();
+    dirtySenders.clear();
+    restored.forEach([&](TxIndex txn) { add(txn); });
+}
+
+void Mempool::loadTip(const map<string, Block>& blocks) {
+    tip = ctx.balances->at(tipHash, blocks);
+}
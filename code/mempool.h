@@ -0,0 +1,101 @@
+/* This file contains the mempool of a peer with its incrementally maintained block template, and the balances
+   at the blocks which the mempools of a simulation share */
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "block.h"
+#include "transaction.h"
+#include "checkpoint.h"
+#include "context.h"
+#include "txset.h"
+using namespace std;
+
+// Referring from constants.cpp
+extern const int maxTransactionsPerBlock;
+extern const double initial_balance;
+extern const double minerReward;
+extern const int recentBalanceVersions;
+extern const string genesisHash;
+
+constexpr int balanceChunkSize = 64; // Peers per chunk of a Balances version
+
+// Balances of all the peers after one block. They are cut into chunks and a block copies only the chunks of the
+// peers it pays or charges, so the versions along a chain share most of their memory. A version never changes
+// once it is built, which lets the peers of every partition read it.
+class Balances {
+public:
+    typedef array<double, balanceChunkSize> Chunk;
+    explicit Balances(int num_peers); // Everyone at initial_balance
+    double operator[](int peer) const { return (*chunks[peer / balanceChunkSize])[peer % balanceChunkSize]; }
+    shared_ptr<const Balances> after(const Block& block, const TransactionTable& table) const;
+private:
+    friend class BalanceCache;
+    vector<shared_ptr<Chunk>> chunks;
+};
+
+// The Balances version of every block that some mempool or a recent reorganisation may still need, by hash. A
+// version is derived from the version of its parent alone, so all the peers on the same tip hold the same version
+// whichever peer or thread built it. Owned by the Simulator.
+class BalanceCache {
+public:
+    explicit BalanceCache(const TransactionTable& table) : table(table) {}
+    shared_ptr<const Balances> genesis(int num_peers);
+    shared_ptr<const Balances> child(const shared_ptr<const Balances>& parent, const Block& block);
+    shared_ptr<const Balances> at(const string& hash, const map<string, Block>& blocks); // Rebuilt from the closest known ancestor
+    long long memoryBytes();
+private:
+    const TransactionTable& table;
+    mutex lock;
+    shared_ptr<const Balances> genesisVersion;
+    map<string, weak_ptr<const Balances>> versions; // Dropped once no mempool holds them
+    deque<shared_ptr<const Balances>> recent;       // The last recentBalanceVersions built, kept for reorganisations
+    size_t pruneAt = 1024;
+    shared_ptr<const Balances> find(const string& hash);
+};
+
+// Pending transactions of a peer by index, queued per sender in the order of the template (newest first), together with
+// the shared balances at the tip of the longest chain. Only the senders with pending transactions have a queue. A
+// transaction goes into the template when its sender can still pay for it after the newer transactions of the same
+// sender, so the template only has to be revisited for the senders whose queue or balance changed since the last
+// mining attempt. A sender appends its transactions to the table in the order of their ids, so the queue of a
+// sender is simply sorted by index.
+class Mempool {
+public:
+    explicit Mempool(SimulationContext& ctx);
+    bool contains(TxIndex txn) const;
+    void add(TxIndex txn);
+    void remove(TxIndex txn);
+    void connectBlock(const Block& block);                                      // The block joined the longest chain
+    void disconnectBlock(const Block& block, const map<string, Block>& blocks); // The block left the longest chain
+    double balance(int peer) const { return (*tip)[peer]; }
+    vector<TxIndex> blockTemplate();          // The transactions of the next block, at most maxTransactionsPerBlock
+    size_t size() const { return pending.size(); }
+    long long memoryBytes() const;
+    void saveState(CheckpointWriter& out);
+    void loadState(CheckpointReader& in);
+    void loadTip(const map<string, Block>& blocks); // After the blockchain of the peer is restored
+
+private:
+    SimulationContext& ctx;
+    TransactionSet pending;                              // Every pending transaction
+    map<int, vector<TxIndex>> bySender;                  // Pending transactions of every sender, oldest first
+    shared_ptr<const Balances> tip;                      // Balances at the tip of the longest chain
+    string tipHash;
+    map<int, vector<int>> selectedBySender;              // Ids of the transactions of every sender in the template
+    map<int, TxIndex, greater<int>> selected;            // Transactions of all the senders which fit the balances
+    set<int> dirtySenders;                               // Senders whose part of the template is out of date
+    void markBlock(const Block& block);
+    void refreshSender(int sender);
+    void markDirty(int sender);
+};
+
+#endif
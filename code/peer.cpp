@@ -1,77 +1,185 @@
 #include "peer.h"
 
-Peer::Peer(Simulator* simulator, int id) : simulator(simulator), id(id) {
+Peer::Peer(Simulator* simulator, int id) : simulator(simulator), ctx(simulator->ctx), id(id), mempool(simulator->ctx) {
     // Default constructor
     isMalicious = false;
     balance = initial_balance; 
-    blockchain = new Blockchain(id); // Create a new blockchain for this peer
+    blockchain = new Blockchain(ctx, id); // Create a new blockchain for this peer
+    latencyRng = RandomStream(ctx.seed, id, RNG_LATENCY);
+    miningRng = RandomStream(ctx.seed, id, RNG_MINING);
+    transactionRng = RandomStream(ctx.seed, id, RNG_TRANSACTIONS);
+    latencyRng.setAntithetic(ctx.antithetic);
+    miningRng.setAntithetic(ctx.antithetic);
+    transactionRng.setAntithetic(ctx.antithetic);
+}
+
+int Peer::generateTransactionID() {
+    // Peers hand out interleaved ids, so the ids do not depend on the order in which the peers run
+    return nextTransactionID++ * ctx.num_nodes + id;
 }
 
 void Peer::generateTransaction() {
     // This function generates a transaction
-    double our_balance = blockchain->getPeerBalance(id);
+    if (isRelayOnly) return; // Without a ledger the balance is unknown, so the peer could not tell which amount it can pay
+    double our_balance = mempool.balance(id);
     if (our_balance <= 0) return; // If we don't have any balance, we can't generate a transaction    
     int targetPeerID = id;
     while (targetPeerID == id) {
-        targetPeerID = uniformRandom(0, num_nodes - 1); // Choose a random peer to send the transaction to
-    }
-    Transaction txn = Transaction(id, targetPeerID, uniformRandom(1, our_balance)); // Create a new transaction with a random amount
-    txPool.insert(txn); // Insert the transaction into the transaction pool
-    
-    for (auto& [id, peer] : malicious_neighbours) {
-        // Send the transaction to all neighbours
-        sendTransaction(txn, peer->id);
+        targetPeerID = uniformRandom(transactionRng, 0, ctx.num_nodes - 1); // Choose a random peer to send the transaction to
     }
-    for (auto& [id, peer] : neighbours) {
-        // Send the transaction to all neighbours
-        sendTransaction(txn, peer->id);
-    }
-    // if (txPool.size() > 100) simulator->scheduleEvent(simulator->getCurrentTime(), MINING_START, id, -1, {});
+    Transaction created = Transaction(generateTransactionID(), id, targetPeerID, uniformRandom(transactionRng, 1, our_balance)); // Create a new transaction with a random amount
+    TxIndex txn = ctx.transactions->append(created);
+    seenTransactions.insert(txn); // Ignore the copies which come back from the neighbours
+    mempool.add(txn); // Insert the transaction into the transaction pool
+    relayTransaction(txn, -1);
+    // if (txPool.size() > 100) simulator->scheduleEvent(simulator->getCurrentTime(id), MINING_START, id, -1, {});
 }
 
-void Peer::receiveTransaction(Transaction txn, int sender_id) {
+void Peer::receiveTransaction(TxIndex txn, int sender_id) {
     // This function is called when a peer receives a transaction
-    if (txIDs.count(txn.getID()) || txn.amount <= 0) return; // If the transaction has already been received, ignore it
-    txIDs.insert(txn.getID());
-    txPool.insert(txn);  // Insert the transaction into the transaction pool
-    for (auto& [id, peer] : malicious_neighbours) {
-        // Send the transaction to all neighbours
-        sendTransaction(txn, peer->id);
-    }
-    for (auto& [id, peer] : neighbours) {
-        // Send the transaction to all neighbours
-        if (peer->id != sender_id) {
-            sendTransaction(txn, peer->id);
-        }
-    }
-    // if (txPool.size() > 100) simulator->scheduleEvent(simulator->getCurrentTime(), MINING_START, id, -1, {});
+    if (seenTransactions.contains(txn) || ctx.transactions->amount(txn) <= 0) return; // If the transaction has already been received, ignore it
+    seenTransactions.insert(txn);
+    if (!isRelayOnly) mempool.add(txn);  // Insert the transaction into the transaction pool
+    relayTransaction(txn, sender_id);
+    // if (txPool.size() > 100) simulator->scheduleEvent(simulator->getCurrentTime(id), MINING_START, id, -1, {});
 }
 
-void Peer::sendTransaction(Transaction txn, int targetPeerID) {
+void Peer::sendTransaction(TxIndex txn, int targetPeerID) {
     // This function is called when a peer sends a transaction
     bool whether_overlay = false;
     if (malicious_neighbours.count(targetPeerID)) whether_overlay = true;
-    simulator->scheduleEvent(simulator->getCurrentTime(), TRANSACTION_SEND, id, targetPeerID, txn, whether_overlay);
+    simulator->scheduleEvent(simulator->getCurrentTime(id), TRANSACTION_SEND, id, targetPeerID, txn, whether_overlay);
+}
+
+void Peer::relayTransaction(TxIndex txn, int sender_id) {
+    // Pass a new transaction on to the neighbours, sender_id is -1 for the transactions of this peer
+    if (ctx.txRelay == FLOOD_TX_RELAY) {
+        for (auto& [id, peer] : malicious_neighbours) {
+            // Send the transaction to all neighbours
+            sendTransaction(txn, peer->id);
+        }
+        for (auto& [id, peer] : neighbours) {
+            // Send the transaction to all neighbours except the sender
+            if (peer->id != sender_id) {
+                sendTransaction(txn, peer->id);
+            }
+        }
+        return;
+    }
+    // Queue the transaction for the next trickle, a neighbour on both networks gets a single announcement
+    for (auto& [nid, peer] : malicious_neighbours) {
+        if (nid != sender_id && !neighbours.count(nid)) pendingInventory[nid].push_back(txn);
+    }
+    for (auto& [nid, peer] : neighbours) {
+        if (nid != sender_id) pendingInventory[nid].push_back(txn);
+    }
+    if (!whether_trickle_scheduled) {
+        whether_trickle_scheduled = true;
+        simulator->scheduleEvent(simulator->getCurrentTime(id) + ctx.trickleInterval, INVENTORY_TRICKLE, id, -1, {});
+    }
+}
+
+// Every node of the map of announcements carries the colour and three pointers on top of the value
+constexpr long long inventoryNodeOverhead = 32;
+
+long long Peer::transactionRelayBytes() {
+    long long bytes = seenTransactions.memoryBytes() + requestedTransactions.memoryBytes();
+    for (auto& [nid, transactions] : pendingInventory) bytes += inventoryNodeOverhead + sizeof(int) + sizeof(transactions) + transactions.capacity() * sizeof(TxIndex);
+    return bytes;
+}
+
+void Peer::sendInventory() {
+    // Announce everything queued since the last trickle, one message per neighbour. The queue of every neighbour
+    // keeps its node and its capacity for the next trickle, the message gets an exact copy.
+    whether_trickle_scheduled = false;
+    for (auto& [nid, transactions] : pendingInventory) {
+        if (transactions.empty()) continue;
+        bool whether_overlay = malicious_neighbours.count(nid) > 0;
+        simulator->scheduleEvent(simulator->getCurrentTime(id), INVENTORY_SEND, id, nid, vector<TxIndex>(transactions), whether_overlay);
+        transactions.clear();
+    }
+}
+
+void Peer::receiveInventory(const vector<TxIndex>& transactions, int sender_id) {
+    // Ask the sender for the announced transactions which are neither known nor already asked from another neighbour
+    vector<TxIndex> missing;
+    for (TxIndex txn : transactions) {
+        if (seenTransactions.contains(txn) || requestedTransactions.contains(txn)) continue;
+        requestedTransactions.insert(txn);
+        if (missing.empty()) missing.reserve(transactions.size()); // A single allocation for the whole request
+        missing.push_back(txn);
+    }
+    if (missing.empty()) return;
+    bool whether_overlay = malicious_neighbours.count(sender_id) > 0;
+    simulator->scheduleEvent(simulator->getCurrentTime(id), GETDATA_SEND, id, sender_id, move(missing), whether_overlay);
+}
+
+void Peer::receiveTransactionRequest(const vector<TxIndex>& transactions, int sender_id) {
+    // Answer a getdata with the requested transactions in one message
+    vector<TxIndex> batch;
+    for (TxIndex txn : transactions) {
+        if (!seenTransactions.contains(txn)) continue;
+        if (batch.empty()) batch.reserve(transactions.size());
+        batch.push_back(txn);
+    }
+    if (batch.empty()) return;
+    bool whether_overlay = malicious_neighbours.count(sender_id) > 0;
+    simulator->scheduleEvent(simulator->getCurrentTime(id), TRANSACTION_BATCH_SEND, id, sender_id, move(batch), whether_overlay);
+}
+
+void Peer::receiveTransactionBatch(const vector<TxIndex>& transactions, int sender_id) {
+    for (TxIndex txn : transactions) {
+        requestedTransactions.erase(txn);
+        receiveTransaction(txn, sender_id);
+    }
 }
 
 /////////////
 void Peer::receiveBlock(Block block, int sender_id) {
 
     // This function is called when a peer receives a block 
-    if(blockchain->blocks.count(block.getBlockHeaderHash())) return; // If the block has already been received, ignore it
-    if (blockchain->hash_to_timeout.count(block.getBlockHeaderHash())) {
-        blockchain->hash_to_timeout.erase(block.getBlockHeaderHash());
+    string hash = block.getBlockHeaderHash();
+    if(blockchain->blocks.count(hash) || pendingValidation.count(hash)) return; // If the block has already been received, ignore it
+    auto fetch = blockFetches.find(hash);
+    if (fetch != blockFetches.end()) {
+        // The outstanding GET requests for the block are dropped, their answers are ignored as duplicates
+        fetchLatencies.push_back(simulator->getCurrentTime(id) - fetch->second.firstAnnounced);
+        blockFetches.erase(fetch);
+    }
+    if (blockchain->hash_to_timeout.count(hash)) {
+        blockchain->hash_to_timeout.erase(hash);
     }
-    if (blockchain->hash_to_queue.count(block.getBlockHeaderHash())) {
-        blockchain->hash_to_queue.erase(block.getBlockHeaderHash());
+    if (blockchain->hash_to_queue.count(hash)) {
+        blockchain->hash_to_queue.erase(hash);
     }
     
-    if(enable_countermeasure) { handleSuccesfulRequest(sender_id); }
+    if(ctx.enable_countermeasure) { handleSuccesfulRequest(sender_id); }
 
-    string old_leaf_node = blockchain->returnLeafNode();
+    if (!ctx.headerFirst && ctx.validationDelay <= 0) {
+        validateReceivedBlock(move(block), sender_id, false);
+        return;
+    }
+    if (ctx.headerFirst && (blockchain->blocks.count(block.parentHash) || pendingValidation.count(block.parentHash))) {
+        // The header links to a block we know, so the block is announced before its transactions are checked
+        announceBlock(block, sender_id);
+        announcedBeforeValidation.insert(hash);
+    }
+    pendingValidation[hash] = {move(block), sender_id};
+    simulator->scheduleEvent(simulator->getCurrentTime(id) + ctx.validationDelay, BLOCK_VALIDATION, id, -1, move(hash));
+}
+
+void Peer::finishValidation(const string& hash) {
+    // The validation of a received block took validationDelay, the block now joins the blockchain
+    auto pending = pendingValidation.find(hash);
+    if (pending == pendingValidation.end()) return;
+    Block block = move(pending->second.first);
+    int sender_id = pending->second.second;
+    pendingValidation.erase(pending);
+    bool whether_announced = announcedBeforeValidation.erase(hash) > 0;
+    validateReceivedBlock(move(block), sender_id, whether_announced);
+}
 
-    bool whether_valid = blockchain->insertBlock(block, simulator->getCurrentTime()); // Insert the block into the blockchain
-    if (!whether_valid) return; // If the block is invalid, ignore it
+void Peer::announceBlock(const Block& block, int sender_id) {
     for (auto& [id, peer]: malicious_neighbours)
     {
         if (peer->id != sender_id)
@@ -79,7 +187,7 @@ void Peer::receiveBlock(Block block, int sender_id) {
             sendHash(block.getBlockHeaderHash(), peer->id);
         }
     }
-    if (!isMalicious || block.minerID != ringMaster) {
+    if (!isMalicious || block.minerID != ctx.ringMaster) {
         for (auto& [id, peer] : neighbours) {
             if (peer->id != sender_id) {
                 // Send the block to all neighbours except the sender
@@ -88,34 +196,104 @@ void Peer::receiveBlock(Block block, int sender_id) {
             }
         }
     }
-    if (isMalicious && block.minerID != ringMaster) {
+}
+
+void Peer::validateReceivedBlock(Block received, int sender_id, bool whether_announced) {
+    string old_leaf_node = blockchain->returnLeafNode();
+    string hash = received.getBlockHeaderHash();
+
+    bool whether_valid = blockchain->insertBlock(move(received), simulator->getCurrentTime(id)); // Insert the block into the blockchain
+    const Block& block = blockchain->blocks[hash]; // Stored even when it turned out invalid
+    if (!whether_valid) {
+        // A peer relaying blocks before validating them loses trust for every invalid block it sends
+        if (ctx.headerFirst && ctx.enable_countermeasure) handleFailedRequest(sender_id);
+        return; // If the block is invalid, ignore it
+    }
+    if (!whether_announced) announceBlock(block, sender_id);
+    if (isMalicious && block.minerID != ctx.ringMaster) {
         // Honest blocks are already in public
-        blockchain->whether_sent_to_honest[block.getBlockHeaderHash()] = true;
+        blockchain->whether_sent_to_honest[hash] = true;
     }
-    logToPeerFile("RECEIVED BLOCK", "Peer " + to_string(id) + " (" + to_string(isMalicious) + ")" + " received block " + (block.getBlockHeaderHash()) + " (with parent id " + (block.parentHash) + ")" + " from peer " + to_string(sender_id) + " at time " + to_string(simulator->getCurrentTime())); // Log the event to the log file
+    logToPeerFile("RECEIVED BLOCK", "Peer " + to_string(id) + " (" + to_string(isMalicious) + ")" + " received block " + hash + " (with parent id " + (block.parentHash) + ")" + " from peer " + to_string(sender_id) + " at time " + to_string(simulator->getCurrentTime(id))); // Log the event to the log file
 
     string new_leaf_node = blockchain->returnLeafNode();
 
-    if (isMalicious && id != ringMaster) return;
+    if (isMalicious && id != ctx.ringMaster) return;
     if (old_leaf_node != new_leaf_node) {
-        simulator->scheduleEvent(simulator->getCurrentTime(), MINING_START, id, -1, {});
+        simulator->scheduleEvent(simulator->getCurrentTime(id), MINING_START, id, -1, {});
+    }
+    if (block.minerID != ctx.ringMaster) {
+        broadcastPrivateChain(hash);
+    }
+}
+
+bool Peer::whether_block_arrived(const string& hash) const {
+    // A compact block waiting for its missing transactions is on its way as well, the sender answers those
+    // requests in any case, so asking for the block again would only blame the sender for the round trip
+    return blockchain->blocks.count(hash) || pendingValidation.count(hash) || pendingCompactBlocks.count(hash);
+}
+
+void Peer::receiveCompactBlock(Block block, int sender_id) {
+    // Rebuild the block from the transactions this peer has seen, the missing ones are asked from the sender
+    string hash = block.getBlockHeaderHash();
+    if (blockchain->blocks.count(hash) || pendingValidation.count(hash) || pendingCompactBlocks.count(hash)) return;
+    compactBlocksReceived++;
+    vector<TxIndex> missing;
+    for (TxIndex txn : ctx.transactions->block(block.transactions)) {
+        if (!seenTransactions.contains(txn)) missing.push_back(txn);
     }
-    if (block.minerID != ringMaster) {
-        broadcastPrivateChain(block.getBlockHeaderHash());
+    if (missing.empty()) {
+        compactBlocksReconstructed++;
+        receiveBlock(move(block), sender_id);
+        return;
     }
+    blockTransactionsRequested += missing.size();
+    pendingCompactBlocks[hash] = move(block);
+    bool whether_overlay = malicious_neighbours.count(sender_id) > 0;
+    simulator->scheduleEvent(simulator->getCurrentTime(id), BLOCK_TRANSACTIONS_REQUEST_SEND, id, sender_id, move(missing), whether_overlay);
+}
+
+void Peer::receiveBlockTransactionRequest(const vector<TxIndex>& transactions, int sender_id) {
+    // The requested transactions belong to a block this peer has sent, so it can always answer
+    bool whether_overlay = malicious_neighbours.count(sender_id) > 0;
+    simulator->scheduleEvent(simulator->getCurrentTime(id), BLOCK_TRANSACTIONS_SEND, id, sender_id, transactions, whether_overlay);
 }
 
-void Peer::sendBlock(Block block, int targetPeerID) {
+void Peer::receiveBlockTransactions(const vector<TxIndex>& transactions, int sender_id) {
+    // The transactions of a block are not relayed, they go to the mempool in case the block does not join the longest chain
+    for (TxIndex txn : transactions) {
+        if (seenTransactions.insert(txn) && !isRelayOnly) mempool.add(txn);
+    }
+    vector<Block> complete;
+    for (auto it = pendingCompactBlocks.begin(); it != pendingCompactBlocks.end();) {
+        bool whether_complete = true;
+        for (TxIndex txn : ctx.transactions->block(it->second.transactions)) {
+            if (!seenTransactions.contains(txn)) {
+                whether_complete = false;
+                break;
+            }
+        }
+        if (!whether_complete) {
+            it++;
+            continue;
+        }
+        complete.push_back(move(it->second));
+        it = pendingCompactBlocks.erase(it);
+    }
+    for (Block& block : complete) receiveBlock(move(block), sender_id);
+}
+
+void Peer::sendBlock(const Block& block, int targetPeerID) {
     // This function is called when a peer sends a block
-    if(!enable_countermeasure || isMalicious) {
+    if(!ctx.enable_countermeasure || isMalicious) {
         bool whether_overlay = false;
-        if (!peers[targetPeerID]->isMalicious && isMalicious) blockchain->whether_sent_to_honest[block.getBlockHeaderHash()] = true;
+        if (!ctx.peers[targetPeerID]->isMalicious && isMalicious) blockchain->whether_sent_to_honest[block.getBlockHeaderHash()] = true;
         if (malicious_neighbours.count(targetPeerID)) whether_overlay = true;
-        simulator->scheduleEvent(simulator->getCurrentTime(), BLOCK_SEND, id, targetPeerID, block, whether_overlay);
+        simulator->scheduleEvent(simulator->getCurrentTime(id), BLOCK_SEND, id, targetPeerID, block, whether_overlay);
 
     } else {
         if(trustScore[targetPeerID] > banThreshold) {
-            double delayedSendTime = simulator->getCurrentTime() + getTrustDelay(targetPeerID);
+            double delayedSendTime = simulator->getCurrentTime(id) + getTrustDelay(targetPeerID);
             simulator->scheduleEvent(delayedSendTime, BLOCK_SEND, id, targetPeerID, block, false);
 
         } else {
@@ -129,10 +307,16 @@ void Peer::sendBlock(Block block, int targetPeerID) {
     }
 }
 
+void Peer::setRelayOnly() {
+    // Switch the peer to header only state, this has to happen before the genesis block is created
+    isRelayOnly = true;
+    blockchain->headerOnly = true;
+}
+
 void Peer::setHashingPower() {
     // This function sets the hashing power of the peer, based on the number of peers and whether the peer is low CPU
     hashingPower = 1;
-    hashingPower /= peers.size();
+    hashingPower /= ctx.peers.size();
 }
 
 
@@ -151,92 +335,87 @@ void Peer::createGenesisBlock() {
     genesisBlock.height = 0;
     blockchain->current_leaf_node = genesisHash;
     blockchain->whether_sent_to_honest[genesisBlock.hashBlockHeader] = true;
-    blockchain->insertBlock(genesisBlock, simulator->getCurrentTime());
+    blockchain->insertBlock(move(genesisBlock), simulator->getCurrentTime(id));
 }
 
 
 string Peer::mining_start() {
     // This function is called when a peer starts mining
     current_mined_block = Block("");
-    int count = 0;
-    
-    vector<double> peerBalancesRightNow(num_nodes); // Get the current balances of all peers
-    for (int i = 0 ; i < num_nodes ; i ++ ) peerBalancesRightNow[i] = blockchain->getPeerBalance(i);
-
-    for (Transaction txn : txPool) {
-        if (peerBalancesRightNow[txn.sender] < txn.amount) {
-            // If the sender doesn't have enough balance, ignore the transaction
-            continue;
-        }
-        peerBalancesRightNow[txn.sender] -= txn.amount;
-        current_mined_block.addTransaction(txn);
-        count++; 
-        if(count >= maxTransactionsPerBlock) {break;}  // If the block is full, stop adding transactions
-    }
+    current_template.clear();
+    // Relay only peers mine empty blocks: without the balances they cannot check that the transactions of a template
+    // are covered, and a block the full nodes reject would waste their hash power, which still counts towards the honest share
+    if (!isRelayOnly) current_template = mempool.blockTemplate();
     current_mined_block.parentHash = blockchain->current_leaf_node; // Set the parent ID of the block
     current_mined_block.minerID = id; // Set the miner ID of the block
     current_mined_block.height = blockchain->getLongestChainHeight(); // Set the height of the block
-    current_mined_block.timestamp_of_creation = simulator->getCurrentTime();
-    current_mined_block.getBlockHeaderHash();
+    current_mined_block.timestamp_of_creation = simulator->getCurrentTime(id);
+    current_mined_block.getBlockHeaderHash(*ctx.transactions, current_template);
     leaf_node = blockchain->current_leaf_node; // Set the leaf node of the block
     return current_mined_block.getBlockHeaderHash();
 }
 
-void Peer::mining_end(string mined_hash) {
+void Peer::mining_end(const string& mined_hash) {
     // This function is called when a peer finishes mining and we need to insert the block into the blockchain
     if (current_mined_block.getBlockHeaderHash() != mined_hash) return;
     if (blockchain->current_leaf_node != leaf_node) return;  // If the leaf node has changed, ignore the block, and we need to start mining again
+    current_mined_block.transactions = ctx.transactions->appendBlock(current_template);
     
-    blockchain->insertBlock(current_mined_block, simulator->getCurrentTime());
+    blockchain->insertBlock(current_mined_block, simulator->getCurrentTime(id));
     for (auto& [id, peer]: malicious_neighbours)
     {
         sendHash(current_mined_block.getBlockHeaderHash(), peer->id);
     }
-    if (id != ringMaster) {
+    if (id != ctx.ringMaster) {
         for (auto& [id, peer] : neighbours) 
         {
             sendHash(current_mined_block.getBlockHeaderHash(), peer->id);
         }
     }  
-    if (id == ringMaster) {
+    if (id == ctx.ringMaster) {
         if (blockchain->whether_sent_to_honest[current_mined_block.parentHash]) {
             selfish_mine_start = current_mined_block.parentHash;
         }
     }
-    if (id == ringMaster) {
-        simulator->scheduleEvent(simulator->getCurrentTime(), MINING_START, id, -1, {});
+    if (id == ctx.ringMaster) {
+        simulator->scheduleEvent(simulator->getCurrentTime(id), MINING_START, id, -1, {});
     }
 }
 
 double Peer::getBlockInterArrivalTime() {
     // This function returns the block inter-arrival time
-    return exponentialRandom( averageBlockArrivalTime / hashingPower );
+    return exponentialRandom(miningRng,  ctx.averageBlockArrivalTime / hashingPower );
 }
 
-void Peer::sendHash(string hash, int targetPeerID)
+void Peer::sendHash(const string& hash, int targetPeerID)
 {
-    if (!peers[targetPeerID]->isMalicious && isMalicious) blockchain->whether_sent_to_honest[hash] = true;
+    if (!ctx.peers[targetPeerID]->isMalicious && isMalicious) blockchain->whether_sent_to_honest[hash] = true;
     bool whether_overlay = false;
     if (malicious_neighbours.count(targetPeerID)) whether_overlay = true;
-    simulator->scheduleEvent(simulator->getCurrentTime(), HASH_SEND, id, targetPeerID, hash, whether_overlay);
+    simulator->scheduleEvent(simulator->getCurrentTime(id), HASH_SEND, id, targetPeerID, hash, whether_overlay);
 }
 
-void Peer::receiveHash(string hash, int sender_id)
+void Peer::receiveHash(const string& hash, int sender_id)
 {
-    if (blockchain->blocks.count(hash)) {
+    if (whether_block_arrived(hash)) {
         return;
     }
+    if (!blockFetches.count(hash)) blockFetches[hash].firstAnnounced = simulator->getCurrentTime(id);
     blockchain->hash_to_queue[hash].push(sender_id);
+    if (ctx.getFanout > 1) {
+        requestBlock(hash);
+        return;
+    }
 
-    if (!blockchain->hash_to_timeout.count(hash) || blockchain->hash_to_timeout[hash] <= simulator->getCurrentTime()) {
-        if(!enable_countermeasure || isMalicious) {
-            blockchain->hash_to_timeout[hash] = simulator->getCurrentTime() + GetRequestTimeout;
+    if (!blockchain->hash_to_timeout.count(hash) || blockchain->hash_to_timeout[hash] <= simulator->getCurrentTime(id)) {
+        if(!ctx.enable_countermeasure || isMalicious) {
+            blockchain->hash_to_timeout[hash] = simulator->getCurrentTime(id) + ctx.GetRequestTimeout;
             sendGetRequest(hash, sender_id);
 
-        } else if(enable_countermeasure && !isMalicious) {
+        } else if(ctx.enable_countermeasure && !isMalicious) {
             if(trustScore[sender_id] > banThreshold) {
-                double delayedRequestTime = simulator->getCurrentTime() + getTrustDelay(sender_id);
-                blockchain->hash_to_timeout[hash] = GetRequestTimeout + delayedRequestTime;
+                double delayedRequestTime = simulator->getCurrentTime(id) + getTrustDelay(sender_id);
+                blockchain->hash_to_timeout[hash] = ctx.GetRequestTimeout + delayedRequestTime;
                 sendDelayedGetRequest(hash, sender_id, delayedRequestTime); 
 
             } else {
@@ -250,22 +429,85 @@ void Peer::receiveHash(string hash, int sender_id)
     }
 }
 
+void Peer::requestBlock(const string& hash)
+{
+    // Ask the announcers in turn until getFanout requests are in flight, at most one every getStagger
+    BlockFetch& fetch = blockFetches[hash];
+    queue<int>& announcers = blockchain->hash_to_queue[hash];
+    double now = simulator->getCurrentTime(id);
+    while (fetch.inFlight < ctx.getFanout && !announcers.empty()) {
+        if (fetch.inFlight > 0 && now < fetch.nextRequestTime) {
+            if (!fetch.whether_timer) {
+                fetch.whether_timer = true;
+                simulator->scheduleEvent(fetch.nextRequestTime, GET_STAGGER, id, -1, hash);
+            }
+            return;
+        }
+        int targetPeerID = announcers.front();
+        announcers.pop();
+        if (ctx.enable_countermeasure && !isMalicious) {
+            if (trustScore[targetPeerID] <= banThreshold) {
+                banCount[targetPeerID] += 1;
+                if (banCount[targetPeerID] > maxBan) {
+                    resetScore(targetPeerID);
+                    banCount[targetPeerID] = 0;
+                }
+                continue;
+            }
+            sendDelayedGetRequest(hash, targetPeerID, now + getTrustDelay(targetPeerID));
+        } else {
+            sendGetRequest(hash, targetPeerID);
+        }
+        fetch.inFlight++;
+        fetch.nextRequestTime = now + ctx.getStagger;
+    }
+    if (fetch.inFlight == 0) abandonBlockFetch(hash);
+}
+
+void Peer::abandonBlockFetch(const string& hash)
+{
+    // No request is in flight and no announcer is left to ask, a new announcement starts the fetch again
+    blockFetches.erase(hash);
+    blockchain->hash_to_queue.erase(hash);
+    blockchain->hash_to_timeout.erase(hash);
+    failedFetches++;
+}
+
+void Peer::handleStagger(const string& hash)
+{
+    auto fetch = blockFetches.find(hash);
+    if (fetch == blockFetches.end() || whether_block_arrived(hash)) return; // The block arrived in the meantime
+    fetch->second.whether_timer = false;
+    requestBlock(hash);
+}
+
 /////////////////
-void Peer::sendGetRequest(string hash, int targetPeerID)
+void Peer::sendGetRequest(const string& hash, int targetPeerID)
 {
     bool whether_overlay = false;
     if (malicious_neighbours.count(targetPeerID)) whether_overlay = true;
-    simulator->scheduleEvent(simulator->getCurrentTime(), GET_SEND, id, targetPeerID, hash, whether_overlay);
+    simulator->scheduleEvent(simulator->getCurrentTime(id), GET_SEND, id, targetPeerID, hash, whether_overlay);
 }
 
-void Peer::sendDelayedGetRequest(string hash, int targetPeerID, double delayedRequestTime)
+void Peer::sendDelayedGetRequest(const string& hash, int targetPeerID, double delayedRequestTime)
 {
     simulator->scheduleEvent(delayedRequestTime, GET_SEND, id, targetPeerID, hash, false);
 }
 
-void Peer::receiveGetRequest(string hash, int sender_id)
+void Peer::receiveGetRequest(const string& hash, int sender_id)
 {
-    if (whether_eclipse_attack && isMalicious && !peers[sender_id]->isMalicious && blockchain->blocks[hash].minerID != ringMaster) {
+    auto pending = pendingValidation.find(hash);
+    if (ctx.whether_eclipse_attack && isMalicious && !ctx.peers[sender_id]->isMalicious && (pending != pendingValidation.end() ? pending->second.first.minerID : blockchain->blocks[hash].minerID) != ctx.ringMaster) {
+        return;
+    }
+    if (pending != pendingValidation.end()) {
+        // With header first relay the block was announced before it was validated
+        sendBlock(pending->second.first, sender_id);
+        return;
+    }
+    if (blockchain->headerOnly) {
+        // Only recent blocks are still available in full
+        if (blockchain->relayCache.count(hash)) sendBlock(blockchain->relayCache[hash], sender_id);
         return;
     }
     sendBlock(blockchain->blocks[hash], sender_id);
@@ -292,7 +534,7 @@ void Peer::handleSuccesfulRequest(int sender_id) {
 
 /////////////
 double Peer::maxTrustDelay() {
-    double maxDelay = 20 * GetRequestTimeout;
+    double maxDelay = 20 * ctx.GetRequestTimeout;
     return maxDelay;
 }
 
@@ -311,7 +553,7 @@ void Peer::resetScore(int neighbour_id) {
 }
 
 void Peer::reportTrust() { 
-    string peerLogFile = "countermeasure/peer" + to_string(id);
+    string peerLogFile = ctx.countermeasureDirectory + "/peer" + to_string(id);
 
     for(auto neighbour: neighbours) {
         int nid = neighbour.second->id;
@@ -319,58 +561,67 @@ void Peer::reportTrust() {
     }
 }
 
-void Peer::handleTimeout(string hash) {
+void Peer::handleTimeout(const string& hash, int targetPeerID) {
+    if (ctx.getFanout > 1) {
+        // One of the parallel requests went unanswered, its slot goes to the next announcer
+        if (whether_block_arrived(hash) || !blockFetches.count(hash)) return;
+        handleFailedRequest(targetPeerID);
+        blockFetches[hash].inFlight--;
+        requestBlock(hash);
+        return;
+    }
     // Pop queue and send next get request
-    if (blockchain->blocks.count(hash) || !blockchain->hash_to_queue.count(hash)) {
+    if (whether_block_arrived(hash) || !blockchain->hash_to_queue.count(hash)) {
         return;
     }
     if(!blockchain->hash_to_queue[hash].empty()) {
         int sender_id = blockchain->hash_to_queue[hash].front();
         handleFailedRequest(sender_id);
 
-        if (debug) {
+        if (ctx.debug) {
             cout << "Peer " << id << " didn't get response from peer " << sender_id << " for hash " << hash << endl;
         }
 
         blockchain->hash_to_queue[hash].pop();
     }
     if (blockchain->hash_to_queue[hash].empty()) {
+        abandonBlockFetch(hash);
         return;
     }
 
     sendGetRequest(hash, blockchain->hash_to_queue[hash].front());
 
-    if (debug) {
-        cout << "Peer " << id << " handled a timeout for hash " << hash << " at time " << simulator->getCurrentTime() << endl;
+    if (ctx.debug) {
+        cout << "Peer " << id << " handled a timeout for hash " << hash << " at time " << simulator->getCurrentTime(id) << endl;
     }
 }
 
-void Peer::broadcastPrivateChain(string receivedHash)
+void Peer::broadcastPrivateChain(const string& receivedHash)
 {
-    if (id != ringMaster) return;
+    if (id != ctx.ringMaster) return;
     if (blockchain->blocks.count(receivedHash) == 0) return;
     if (blockchain->blocks[receivedHash].height <= blockchain->blocks[selfish_mine_start].height) return;
     int longestHonestChainHeight = 0, longestPrivateChainHeight = 0;
-    for (auto block_checking : blockchain->blocks)
+    for (const auto& block_checking : blockchain->blocks)
     {
         if (blockchain->whether_sent_to_honest[block_checking.first]) longestHonestChainHeight = max(longestHonestChainHeight, block_checking.second.height);
         else longestPrivateChainHeight = max(longestPrivateChainHeight, block_checking.second.height);
     }
     if ((longestHonestChainHeight == longestPrivateChainHeight) || (longestPrivateChainHeight == 1 + longestHonestChainHeight))
     {
-        receivePrivateMessage("PRIVATE " + to_string(getBroadCastNumber()), id);
+        receivePrivateMessage("PRIVATE " + to_string(ctx.getBroadCastNumber()), id);
     }
 }
 
-void Peer::receivePrivateMessage(string message, int sender_id)
+void Peer::receivePrivateMessage(const string& message, int sender_id)
 {
     int bid = stoi(message.substr(8));
     if (allBroadcastIDs.count(bid)) return;
     allBroadcastIDs.insert(bid);
-    for (auto neighbour : malicious_neighbours)
+    for (const auto& neighbour : malicious_neighbours)
     {
         if (neighbour.first != sender_id)
-        simulator->scheduleEvent(simulator->getCurrentTime(), PRIVATE_MESSAGE_SEND, id, neighbour.first, message, true);
+        simulator->scheduleEvent(simulator->getCurrentTime(id), PRIVATE_MESSAGE_SEND, id, neighbour.first, message, true);
     }
     string current_node = blockchain->current_leaf_node;
     vector<string> hashes_to_be_sent;
@@ -381,14 +632,112 @@ void Peer::receivePrivateMessage(string message, int sender_id)
         current_node = blockchain->blocks[current_node].parentHash;
     }
     reverse(hashes_to_be_sent.begin(), hashes_to_be_sent.end());
-    for (int i = 0 ; i < hashes_to_be_sent.size() ; i ++) {
-        for (auto neighbour : neighbours) {
-            if (!peers[neighbour.first]->isMalicious && neighbour.first != sender_id) sendHash(hashes_to_be_sent[i], neighbour.first);
+    for (int i = 0 ; i < (int)hashes_to_be_sent.size() ; i ++) {
+        for (const auto& neighbour : neighbours) {
+            if (!ctx.peers[neighbour.first]->isMalicious && neighbour.first != sender_id) sendHash(hashes_to_be_sent[i], neighbour.first);
         }
     }
 }
 
-void Peer::logToPeerFile(string action, string details) {
-    string peerLogFile = "logFiles/logs" + to_string(id);
+void Peer::logToPeerFile(const string& action, const string& details) {
+    if (!ctx.whether_logging) return;
+    string peerLogFile = ctx.logDirectory + "/logs" + to_string(id);
+    logBytesWritten += action.size() + details.size() + 4;
     logToFile(action, details, peerLogFile);
-}
\ No newline at end of file
+}
+void Peer::saveState(CheckpointWriter& out) {
+    // Write everything this peer knows, the neighbours as peer ids
+    out.write(isMalicious);
+    out.write(isRelayOnly);
+    out.write(hashingPower);
+    out.write(interArrivalTime);
+    out.write(balance);
+    out.write(logBytesWritten);
+    out.write(latencyRng);
+    out.write(miningRng);
+    out.write(transactionRng);
+    out.write(nextEventSequence);
+    out.write(nextTransactionID);
+    vector<int> neighbourIDs, maliciousNeighbourIDs;
+    for (auto& [nid, peer] : neighbours) neighbourIDs.push_back(nid);
+    for (auto& [nid, peer] : malicious_neighbours) maliciousNeighbourIDs.push_back(nid);
+    out.write(neighbourIDs);
+    out.write(maliciousNeighbourIDs);
+    mempool.saveState(out);
+    seenTransactions.saveState(out);
+    requestedTransactions.saveState(out);
+    out.write(pendingInventory);
+    out.write(whether_trickle_scheduled);
+    out.write(pendingCompactBlocks);
+    out.write(pendingValidation);
+    out.write(announcedBeforeValidation);
+    out.write(blockFetches);
+    out.write(fetchLatencies);
+    out.write(failedFetches);
+    out.write(uplinkQueue);
+    out.write(edgeQueues);
+    out.write(queuedMessages);
+    out.write(queueingDelay);
+    out.write(edgeTraffic);
+    out.write(compactBlocksReceived);
+    out.write(compactBlocksReconstructed);
+    out.write(blockTransactionsRequested);
+    out.write(allBroadcastIDs);
+    out.write(selfish_mine_start);
+    out.write(trustScore);
+    out.write(banCount);
+    out.write(pastAttempts);
+    out.write(current_mined_block);
+    out.write(current_template);
+    out.write(leaf_node);
+    blockchain->saveState(out);
+}
+
+void Peer::loadState(CheckpointReader& in) {
+    // Counterpart of saveState, all the peers must exist before the first one is loaded
+    in.read(isMalicious);
+    in.read(isRelayOnly);
+    in.read(hashingPower);
+    in.read(interArrivalTime);
+    in.read(balance);
+    in.read(logBytesWritten);
+    in.read(latencyRng);
+    in.read(miningRng);
+    in.read(transactionRng);
+    in.read(nextEventSequence);
+    in.read(nextTransactionID);
+    vector<int> neighbourIDs, maliciousNeighbourIDs;
+    in.read(neighbourIDs);
+    in.read(maliciousNeighbourIDs);
+    for (int nid : neighbourIDs) neighbours[nid] = ctx.peers.at(nid);
+    for (int nid : maliciousNeighbourIDs) malicious_neighbours[nid] = ctx.peers.at(nid);
+    mempool.loadState(in);
+    seenTransactions.loadState(in);
+    requestedTransactions.loadState(in);
+    in.read(pendingInventory);
+    in.read(whether_trickle_scheduled);
+    in.read(pendingCompactBlocks);
+    in.read(pendingValidation);
+    in.read(announcedBeforeValidation);
+    in.read(blockFetches);
+    in.read(fetchLatencies);
+    in.read(failedFetches);
+    in.read(uplinkQueue);
+    in.read(edgeQueues);
+    in.read(queuedMessages);
+    in.read(queueingDelay);
+    in.read(edgeTraffic);
+    in.read(compactBlocksReceived);
+    in.read(compactBlocksReconstructed);
+    in.read(blockTransactionsRequested);
+    in.read(allBroadcastIDs);
+    in.read(selfish_mine_start);
+    in.read(trustScore);
+    in.read(banCount);
+    in.read(pastAttempts);
+    in.read(current_mined_block);
+    in.read(current_template);
+    in.read(leaf_node);
+    blockchain->loadState(in);
+    mempool.loadTip(blockchain->blocks);
+}
@@ -8,56 +8,102 @@
 #include "blockchain.h"
 #include "simulator.h"
 #include "helper.h"
+#include "context.h"
+#include "rng.h"
+#include "checkpoint.h"
+#include "mempool.h"
+#include "txset.h"
 #include <iostream>
 #include <set>
 #include <map>
 #include <cassert>
 using namespace std;
 
-// Referring from main.cpp
+// Referring from constants.cpp
 extern const int maxTransactionsPerBlock;
 extern const double initial_balance;
-extern double averageBlockArrivalTime;
-extern int num_nodes;
-extern vector<Peer*> peers;
 extern const string genesisHash;
-extern int GetRequestTimeout;
-extern int ringMaster;
-extern bool whether_eclipse_attack;
-extern bool debug;
+
+// A block this peer heard of and is fetching from the peers which announced it
+struct BlockFetch {
+    double firstAnnounced = 0;  // Time of the first announcement, the fetch latency is measured from here
+    int inFlight = 0;           // GET requests sent and neither answered nor timed out, with --get-fanout above 1
+    double nextRequestTime = 0; // Earliest time of the next parallel GET request with --get-stagger
+    bool whether_timer = false; // A GET_STAGGER event is scheduled for the block
+};
+
+// Time until which a link of the peer is busy sending earlier messages, see --link-model
+struct LinkQueue {
+    double busyUntil = 0;      // End of the last message on the link
+    double blockBusyUntil = 0; // End of the last block message, which is all the block traffic waits for with --block-priority
+};
 
 // Forward declaration of the Simulator and Blockchain classes
 class Simulator;
 class Blockchain;
 class Peer {
+    Simulator* simulator; // Declared ahead of id, which the constructor initialises after them
+    SimulationContext& ctx;
 public:
     Peer(Simulator* simulator, int id); 
     ~Peer();
     void generateTransaction(); 
-    void receiveTransaction(Transaction txn, int sender_id);
+    void receiveTransaction(TxIndex txn, int sender_id);
     void receiveBlock(Block block, int sender_id);     
-    void sendTransaction(Transaction txn, int targetPeerID); 
+    void finishValidation(const string& hash);
+    void sendTransaction(TxIndex txn, int targetPeerID); 
+    void relayTransaction(TxIndex txn, int sender_id);
+    void sendInventory();
+    void receiveInventory(const vector<TxIndex>& transactions, int sender_id);
+    void receiveTransactionRequest(const vector<TxIndex>& transactions, int sender_id);
+    void receiveTransactionBatch(const vector<TxIndex>& transactions, int sender_id);
+    void receiveCompactBlock(Block block, int sender_id);
+    void receiveBlockTransactionRequest(const vector<TxIndex>& transactions, int sender_id);
+    void receiveBlockTransactions(const vector<TxIndex>& transactions, int sender_id);
+    long long compactBlocksReceived = 0;      // Compact blocks this peer started to rebuild
+    long long compactBlocksReconstructed = 0; // Compact blocks this peer rebuilt from the transactions it already knew
+    long long blockTransactionsRequested = 0; // Transactions of compact blocks this peer had to ask for
     double interArrivalTime;       
     void setHashingPower();
-    void sendBlock(Block block, int targetPeerID);
+    void sendBlock(const Block& block, int targetPeerID);
     int id;                       
     map<int, Peer*> neighbours; 
     map<int, Peer*> malicious_neighbours;
     bool isMalicious;
+    bool isRelayOnly = false; // Relay only peers keep headers instead of the ledger and do not create transactions
+    void setRelayOnly();
     double getBlockInterArrivalTime();
     void createGenesisBlock();
     string mining_start();
-    void mining_end(string mined_hash);
+    void mining_end(const string& mined_hash);
     Blockchain* blockchain;        
-    multiset<Transaction> txPool;
-    void sendHash(string hash, int targetPeerID);
-    void receiveHash(string hash, int sender_id);
-    void sendGetRequest(string hash, int targetPeerID);
-    void receiveGetRequest(string hash, int sender_id);
-    void handleTimeout(string hash);
+    Mempool mempool;
+    void sendHash(const string& hash, int targetPeerID);
+    void receiveHash(const string& hash, int sender_id);
+    void sendGetRequest(const string& hash, int targetPeerID);
+    void receiveGetRequest(const string& hash, int sender_id);
+    void handleTimeout(const string& hash, int targetPeerID);
+    void requestBlock(const string& hash);
+    void handleStagger(const string& hash);
+    map<string, BlockFetch> blockFetches; // Blocks announced to this peer and not received yet
+    vector<double> fetchLatencies;        // Time between the first announcement and the arrival of every fetched block
+    long long failedFetches = 0;          // Fetches given up because every announcer was asked without an answer
+    void abandonBlockFetch(const string& hash);
+    LinkQueue uplinkQueue;                // Shared by all the messages of the peer with --link-model uplink
+    map<int, LinkQueue> edgeQueues;       // One per target and network (2 * target + overlay) with --link-model edge
+    long long queuedMessages = 0;         // Messages sent through a link queue
+    double queueingDelay = 0;             // Total time those messages waited for the link
+    map<int, pair<long long, long long>> edgeTraffic; // Messages and bytes per target and network (2 * target + overlay) with --traffic-edges
     double hashingPower;  
-    void broadcastPrivateChain(string receivedHash);  
-    void receivePrivateMessage(string message, int sender_id);
+    long long logBytesWritten = 0; // Bytes this peer wrote to its log file
+    RandomStream latencyRng;       // Latencies of the messages this peer sends
+    RandomStream miningRng;        // Block inter arrival times
+    RandomStream transactionRng;   // Transaction inter arrival times, targets and amounts
+    long long nextEventSequence = 0; // Order of the events this peer schedules at the same time
+    int nextTransactionID = 0;
+    int generateTransactionID();
+    void broadcastPrivateChain(const string& receivedHash);
+    void receivePrivateMessage(const string& message, int sender_id);
     set<int> allBroadcastIDs;
     string selfish_mine_start = genesisHash;
 
@@ -69,15 +115,27 @@ public:
     void resetScore(int neighbour_id);
     double maxTrustDelay();
     double getTrustDelay(int sender_id);
-    void sendDelayedGetRequest(string hash, int targetPeerID, double delayedTime);
+    void sendDelayedGetRequest(const string& hash, int targetPeerID, double delayedTime);
     void reportTrust();
-    void logToPeerFile(string action, string details);
+    void logToPeerFile(const string& action, const string& details);
+    long long transactionRelayBytes(); // Seen and requested transactions and the queued announcements
+    void saveState(CheckpointWriter& out);
+    void loadState(CheckpointReader& in);
 
 private:
-    Simulator* simulator;          
     double balance;                
-    set<int> txIDs; 
+    TransactionSet seenTransactions; // Transactions this peer has created or received
+    TransactionSet requestedTransactions; // Transactions asked from a neighbour with a getdata and not received yet
+    map<int, vector<TxIndex>> pendingInventory; // Transactions to announce to every neighbour at the next trickle
+    bool whether_trickle_scheduled = false;
+    map<string, Block> pendingCompactBlocks; // Compact blocks waiting for the transactions this peer asked for
+    map<string, pair<Block, int>> pendingValidation; // Received blocks and their senders, until validationDelay has passed
+    set<string> announcedBeforeValidation;           // Blocks of pendingValidation already announced with header first relay
+    bool whether_block_arrived(const string& hash) const; // Stored, waiting for its validation or for the missing transactions of its compact form
+    void announceBlock(const Block& block, int sender_id);
+    void validateReceivedBlock(Block block, int sender_id, bool whether_announced);
     Block current_mined_block;
+    vector<TxIndex> current_template; // Transactions of current_mined_block, added to the table once it is mined
     string leaf_node = "";         
 };
 
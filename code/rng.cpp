@@ -0,0 +1,98 @@
+#include "rng.h"
+#include <immintrin.h>
+
+constexpr uint32_t PHILOX_M0 = 0xD2511F53, PHILOX_M1 = 0xCD9E8D57;
+constexpr uint32_t PHILOX_W0 = 0x9E3779B9, PHILOX_W1 = 0xBB67AE85;
+
+array<uint32_t, 4> philox4x32(array<uint32_t, 4> counter, array<uint32_t, 2> key) {
+    // Ten rounds of multiply and xor with a Weyl sequence bump of the key between rounds (Salmon et al., SC'11)
+    for (int round = 0; round < 10; round++) {
+        uint64_t product0 = (uint64_t)PHILOX_M0 * counter[0];
+        uint64_t product1 = (uint64_t)PHILOX_M1 * counter[2];
+        counter = {(uint32_t)(product1 >> 32) ^ counter[1] ^ key[0], (uint32_t)product1,
+                   (uint32_t)(product0 >> 32) ^ counter[3] ^ key[1], (uint32_t)product0};
+        key[0] += PHILOX_W0;
+        key[1] += PHILOX_W1;
+    }
+    return counter;
+}
+
+void philoxBlocksScalar(uint32_t* out, int blocks, uint64_t firstBlock, uint32_t stream, uint32_t purpose, array<uint32_t, 2> key) {
+    // The stream and the purpose fill the upper half of the counter, the block number the lower half
+    for (int i = 0; i < blocks; i++) {
+        uint64_t block = firstBlock + i;
+        array<uint32_t, 4> result = philox4x32({(uint32_t)block, (uint32_t)(block >> 32), stream, purpose}, key);
+        memcpy(out + 4 * i, result.data(), sizeof(result));
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void philoxBlocksAVX2(uint32_t* out, int blocks, uint64_t firstBlock, uint32_t stream, uint32_t purpose, array<uint32_t, 2> key) {
+    // Eight blocks at a time, one per 32 bit lane. The 32x32->64 bit products of the even and the odd lanes
+    // are taken separately and recombined into the high and the low words.
+    const __m256i m0 = _mm256_set1_epi32(PHILOX_M0), m1 = _mm256_set1_epi32(PHILOX_M1);
+    int i = 0;
+    for (; i + 8 <= blocks; i += 8) {
+        alignas(32) uint32_t low[8], high[8];
+        for (int lane = 0; lane < 8; lane++) {
+            uint64_t block = firstBlock + i + lane;
+            low[lane] = (uint32_t)block;
+            high[lane] = (uint32_t)(block >> 32);
+        }
+        __m256i c0 = _mm256_load_si256((const __m256i*)low), c1 = _mm256_load_si256((const __m256i*)high);
+        __m256i c2 = _mm256_set1_epi32(stream), c3 = _mm256_set1_epi32(purpose);
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            __m256i even0 = _mm256_mul_epu32(c0, m0), odd0 = _mm256_mul_epu32(_mm256_srli_epi64(c0, 32), m0);
+            __m256i even1 = _mm256_mul_epu32(c2, m1), odd1 = _mm256_mul_epu32(_mm256_srli_epi64(c2, 32), m1);
+            __m256i lo0 = _mm256_blend_epi32(even0, _mm256_slli_epi64(odd0, 32), 0xAA);
+            __m256i hi0 = _mm256_blend_epi32(_mm256_srli_epi64(even0, 32), odd0, 0xAA);
+            __m256i lo1 = _mm256_blend_epi32(even1, _mm256_slli_epi64(odd1, 32), 0xAA);
+            __m256i hi1 = _mm256_blend_epi32(_mm256_srli_epi64(even1, 32), odd1, 0xAA);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(k0));
+            c1 = lo1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(k1));
+            c3 = lo0;
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        alignas(32) uint32_t word[4][8];
+        _mm256_store_si256((__m256i*)word[0], c0);
+        _mm256_store_si256((__m256i*)word[1], c1);
+        _mm256_store_si256((__m256i*)word[2], c2);
+        _mm256_store_si256((__m256i*)word[3], c3);
+        for (int lane = 0; lane < 8; lane++) {
+            for (int w = 0; w < 4; w++) out[4 * (i + lane) + w] = word[w][lane];
+        }
+    }
+    _mm256_zeroupper(); // Dirty upper halves slow down the SSE code that runs next, log() in particular
+    philoxBlocksScalar(out + 4 * i, blocks - i, firstBlock + i, stream, purpose, key);
+}
+
+bool philoxHasAVX2() {
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+}
+#else
+bool philoxHasAVX2() { return false; }
+#endif
+
+void philoxBlocks(uint32_t* out, int blocks, uint64_t firstBlock, uint32_t stream, uint32_t purpose, array<uint32_t, 2> key) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (philoxHasAVX2()) {
+        philoxBlocksAVX2(out, blocks, firstBlock, stream, purpose, key);
+        return;
+    }
+#endif
+    philoxBlocksScalar(out, blocks, firstBlock, stream, purpose, key);
+}
+
+RandomStream::RandomStream(uint64_t seed, uint32_t stream, uint32_t purpose)
+    : key{(uint32_t)seed, (uint32_t)(seed >> 32)}, stream(stream), purpose(purpose) {}
+
+void RandomStream::refill() {
+    philoxBlocks(words.data(), bufferBlocks, counter, stream, purpose, key);
+    counter += bufferBlocks;
+    used = 0;
+}
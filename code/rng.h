@@ -0,0 +1,86 @@
+/* This file contains the counter based random number streams of the simulation */
+#ifndef RNG_H
+#define RNG_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+// What a stream is used for. Every peer has its own stream per purpose, so the numbers a peer draws do not
+// depend on the order in which the events of the other peers are handled.
+enum RngPurpose : uint32_t {
+    RNG_LATENCY,
+    RNG_MINING,
+    RNG_TRANSACTIONS,
+    RNG_TOPOLOGY,
+    RNG_MARKOV    // Runs of the Markov chain engine, one stream per run
+};
+
+// Streams of the topology purpose which do not belong to a peer
+enum TopologyStream : uint32_t {
+    HONEST_NETWORK_STREAM,
+    OVERLAY_NETWORK_STREAM,
+    MALICIOUS_PEERS_STREAM,
+    RINGMASTER_STREAM,
+    OBSERVERS_STREAM
+};
+
+// The Philox4x32-10 block function: maps a 128 bit counter and a 64 bit key to 128 random bits
+array<uint32_t, 4> philox4x32(array<uint32_t, 4> counter, array<uint32_t, 2> key);
+
+// Writes the blocks firstBlock .. firstBlock+blocks-1 of a stream to out, four words per block. Uses the AVX2
+// kernel when the processor has it, both kernels give the same words.
+void philoxBlocks(uint32_t* out, int blocks, uint64_t firstBlock, uint32_t stream, uint32_t purpose, array<uint32_t, 2> key);
+void philoxBlocksScalar(uint32_t* out, int blocks, uint64_t firstBlock, uint32_t stream, uint32_t purpose, array<uint32_t, 2> key);
+bool philoxHasAVX2();
+
+// A stream of random numbers identified by (seed, stream, purpose). The n-th number of a stream is a pure
+// function of these and n, so no state is shared between streams. Usable with the <random> distributions,
+// the simulation itself draws through nextUniform and nextExponential.
+class RandomStream {
+public:
+    using result_type = uint32_t;
+    static constexpr int bufferBlocks = 8; // Blocks generated per refill, one pass of the AVX2 kernel
+    RandomStream() : RandomStream(0, 0, 0) {}
+    RandomStream(uint64_t seed, uint32_t stream, uint32_t purpose);
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+    result_type operator()() {
+        if (used == bufferBlocks * 4) refill();
+        return antithetic ? ~words[used++] : words[used++];
+    }
+    double nextUniform() {
+        // Uniform in [0, 1) from 52 random bits placed in the mantissa of a number in [1, 2)
+        if (used + 2 > bufferBlocks * 4) refill();
+        uint64_t mantissa = ((uint64_t)words[used] << 20) | (words[used + 1] >> 12);
+        if (antithetic) mantissa ^= 0xFFFFFFFFFFFFFull; // 1 - 2^-52 - u, which stays in [0, 1)
+        uint64_t bits = 0x3FF0000000000000ull | mantissa;
+        used += 2;
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value - 1.0;
+    }
+    double nextExponential(double mean) {
+        return -mean * log(1.0 - nextUniform());
+    }
+    void reseed(uint64_t seed) {
+        // Start the same stream and purpose over under another key
+        bool flipped = antithetic;
+        *this = RandomStream(seed, stream, purpose);
+        antithetic = flipped;
+    }
+    void setAntithetic(bool value) { antithetic = value; }
+private:
+    array<uint32_t, 2> key;
+    uint32_t stream;
+    uint32_t purpose;
+    uint64_t counter = 0; // Number of blocks drawn so far
+    array<uint32_t, bufferBlocks * 4> words;
+    int used = bufferBlocks * 4; // Words of the buffer already returned
+    bool antithetic = false;     // Return the mirror image u -> 1 - u of every number
+    void refill();
+};
+
+#endif
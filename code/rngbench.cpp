@@ -0,0 +1,59 @@
+// Micro benchmark of the random number generation, build with make rngbench and run ./rngbench [draws]
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "rng.h"
+using namespace std;
+
+// Delay parameters of a message between two fast peers, as in calculateLatency
+constexpr double minDelay = 10, maxDelay = 500, meanQueuingDelay = 96.0 / 100e6;
+
+template <typename Body>
+double nanosecondsPerCall(long long calls, Body body) {
+    auto start = chrono::steady_clock::now();
+    for (long long i = 0; i < calls; i++) body();
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / calls;
+}
+
+int main(int argc, char* argv[]) {
+    long long draws = argc > 1 ? stoll(argv[1]) : 10000000;
+    volatile double sink = 0;
+
+    // Latency draws of one message: the distributions built on every call against the buffered stream
+    mt19937 gen(1);
+    double perMessageStd = nanosecondsPerCall(draws, [&]() {
+        uniform_real_distribution<> uniform(minDelay, maxDelay);
+        exponential_distribution<> exponential(1.0 / meanQueuingDelay);
+        sink = sink + uniform(gen) + exponential(gen);
+    });
+    RandomStream stream(1, 0, RNG_LATENCY);
+    double perMessageStream = nanosecondsPerCall(draws, [&]() {
+        sink = sink + minDelay + (maxDelay - minDelay) * stream.nextUniform() + stream.nextExponential(meanQueuingDelay);
+    });
+
+    // Raw block generation of the two Philox kernels, which must agree word for word
+    int blocks = RandomStream::bufferBlocks;
+    vector<uint32_t> scalarWords(4 * blocks), simdWords(4 * blocks);
+    long long refills = draws / blocks;
+    uint64_t block = 0;
+    double perBlockScalar = nanosecondsPerCall(refills, [&]() {
+        philoxBlocksScalar(scalarWords.data(), blocks, block += blocks, 0, RNG_LATENCY, {1, 0});
+        sink = sink + scalarWords[0];
+    }) / blocks;
+    block = 0;
+    double perBlockDispatch = nanosecondsPerCall(refills, [&]() {
+        philoxBlocks(simdWords.data(), blocks, block += blocks, 0, RNG_LATENCY, {1, 0});
+        sink = sink + simdWords[0];
+    }) / blocks;
+    bool agree = scalarWords == simdWords;
+
+    cout << "Latency draws per message, std distributions (ns): " << perMessageStd << endl;
+    cout << "Latency draws per message, buffered stream (ns): " << perMessageStream << endl;
+    cout << "Speedup per message: " << perMessageStd / perMessageStream << endl;
+    cout << "Philox block, scalar kernel (ns): " << perBlockScalar << endl;
+    cout << "Philox block, " << (philoxHasAVX2() ? "AVX2" : "scalar") << " kernel (ns): " << perBlockDispatch << endl;
+    cout << "Kernels agree: " << (agree ? "yes" : "no") << endl;
+    return agree ? 0 : 1;
+}
@@ -1,30 +1,23 @@
 import sys
-import subprocess
 import numpy as np
 import json
 import matplotlib.pyplot as plt
+from selfishsim import Simulation
 
 
 def run_simulation(num_peer=100, percent_malicious=50, Ttx=10, Tk=100, get_timeout=20, total_time=17500, iterations=3):
     print(f"Running simulation with num_peer={num_peer}, percent_malicious={percent_malicious}, Ttx={Ttx}, Tk={Tk}, get_timeout={get_timeout}, total_time={total_time}")
-    outputs = [subprocess.run(["./run", str(num_peer), str(percent_malicious), str(Ttx), str(Tk), str(get_timeout), str(total_time), "--ratio"], 
-                              capture_output=True, text=True).stdout for _ in range(iterations)]
+    # The runs share one in-process simulation from libselfishsim.so, every run draws a new random seed
+    simulation = Simulation(num_peer, percent_malicious, Ttx, Tk, get_timeout, total_time)
+    outputs = [simulation.run(seed=np.random.randint(2**63)).metrics() for _ in range(iterations)]
     print(outputs)
     
-    def extract_value(output, key):
-        for line in output.splitlines():
-            # print(line)
-            if key in line:
-                value = line.split(':')[1]
-                value = value[1:]
-                return np.nan if value == "-nan" else float(value)
-        return np.nan  # If the key is not found, return NaN
-    
-    categories = ["Malicious Blocks in Chain / Total Blocks in Longest Chain", "Malicious Blocks in Chain / Total Malicious Blocks"]
+    categories = {"Malicious Blocks in Chain / Total Blocks in Longest Chain": "ratio_malicious_total",
+                  "Malicious Blocks in Chain / Total Malicious Blocks": "ratio_malicious_totalMalicious"}
     results = {}
     
-    for category in categories:
-        values = [extract_value(output, category) for output in outputs]
+    for category, key in categories.items():
+        values = [output[key] for output in outputs]
         filtered_values = [v for v in values if not np.isnan(v)]
         print(f"Values for {category}: {values}")
         results[category] = np.mean(filtered_values) if filtered_values else np.nan
@@ -0,0 +1,136 @@
+// Implementation of the C API of libselfishsim.so on top of the in-process driver
+#include <exception>
+#include <map>
+#include <queue>
+#include <set>
+#include <string>
+#include <vector>
+#include "selfishsim.h"
+#include "blockchain.h"
+#include "context.h"
+#include "driver.h"
+#include "peer.h"
+using namespace std;
+
+struct ssim_simulation {
+    SimulationContext config;
+    bool whether_finished = false;
+    SimulationResult result;
+    int ringMaster = -1;
+    string error;
+    // Columns of the block tree handed out by ssim_get_blocks
+    vector<int32_t> miner, parent, height;
+    vector<double> arrival;
+    vector<uint8_t> malicious, inChain;
+};
+
+static void collectBlocks(ssim_simulation* simulation, SimulationContext& ctx) {
+    // Walk the tree of the ringmaster breadth first from the genesis block, so every parent comes before its children
+    simulation->ringMaster = ctx.ringMaster;
+    if (ctx.ringMaster == -1) return;
+    Blockchain* chain = ctx.peers[ctx.ringMaster]->blockchain;
+    set<string> longestChain;
+    for (Block& block : chain->currentChain()) longestChain.insert(block.hashBlockHeader);
+    map<string, int32_t> index;
+    queue<string> blocks;
+    blocks.push(genesisHash);
+    while (!blocks.empty()) {
+        string parent_id = blocks.front();
+        blocks.pop();
+        auto children = chain->children_block_ids.find(parent_id);
+        if (children == chain->children_block_ids.end()) continue;
+        for (const string& child_id : children->second) {
+            Block& block = chain->blocks[child_id];
+            index[child_id] = simulation->miner.size();
+            simulation->miner.push_back(block.minerID);
+            simulation->parent.push_back(parent_id == genesisHash ? -1 : index[parent_id]);
+            simulation->height.push_back(block.height);
+            simulation->arrival.push_back(chain->block_to_timestamp[child_id]);
+            simulation->malicious.push_back(ctx.peers[block.minerID]->isMalicious);
+            simulation->inChain.push_back(longestChain.count(child_id));
+            blocks.push(child_id);
+        }
+    }
+}
+
+extern "C" {
+
+int ssim_api_version(void) { return SSIM_API_VERSION; }
+
+ssim_simulation* ssim_create(int num_nodes, double malicious_percentage, double mean_transaction_time,
+                             double average_block_arrival_time, int get_request_timeout, int total_execution_time,
+                             int num_flags, const char* const* flags) {
+    ssim_simulation* simulation = new ssim_simulation();
+    SimulationContext& config = simulation->config;
+    vector<string> args;
+    for (int i = 0; i < num_flags; i++) args.push_back(flags[i]);
+    bool valid = false;
+    try {
+        valid = parseFlags(config, args);
+    } catch (const exception& e) {
+        valid = false;
+    }
+    if (!valid || config.engine != "event") {
+        delete simulation;
+        return nullptr;
+    }
+    config.num_nodes = num_nodes;
+    config.malicious_percentage = malicious_percentage;
+    config.meanTransactionTime = mean_transaction_time;
+    config.averageBlockArrivalTime = average_block_arrival_time;
+    config.GetRequestTimeout = get_request_timeout;
+    config.totalExecutionTime = total_execution_time;
+    return simulation;
+}
+
+void ssim_destroy(ssim_simulation* simulation) { delete simulation; }
+
+void ssim_set_seed(ssim_simulation* simulation, uint64_t seed) { simulation->config.seed = seed; }
+
+int ssim_run(ssim_simulation* simulation) {
+    simulation->whether_finished = false;
+    simulation->error.clear();
+    simulation->ringMaster = -1;
+    for (auto* column : {&simulation->miner, &simulation->parent, &simulation->height}) column->clear();
+    simulation->arrival.clear();
+    simulation->malicious.clear();
+    simulation->inChain.clear();
+    try {
+        simulation->result = runSimulation(simulation->config, [&](SimulationContext& ctx) { collectBlocks(simulation, ctx); });
+    } catch (const exception& e) {
+        simulation->error = e.what();
+        return 1;
+    }
+    simulation->whether_finished = true;
+    return 0;
+}
+
+const char* ssim_last_error(const ssim_simulation* simulation) { return simulation->error.c_str(); }
+
+int ssim_get_metrics(const ssim_simulation* simulation, ssim_metrics* metrics) {
+    if (!simulation->whether_finished) return 1;
+    const SimulationResult& result = simulation->result;
+    metrics->ratio_malicious_total = result.ratio_malicious_total;
+    metrics->ratio_malicious_totalMalicious = result.ratio_malicious_totalMalicious;
+    metrics->malicious_blocks_chain = result.numMaliciousBlocks_chain;
+    metrics->honest_blocks_chain = result.numHonestBlocks_chain;
+    metrics->total_malicious_blocks = result.totalMaliciousBlocks;
+    metrics->ringmaster = simulation->ringMaster;
+    metrics->events_processed = result.eventsProcessed;
+    metrics->wall_time = result.wallTime;
+    return 0;
+}
+
+int ssim_get_blocks(const ssim_simulation* simulation, ssim_blocks* blocks) {
+    if (!simulation->whether_finished) return 1;
+    blocks->count = simulation->miner.size();
+    blocks->miner = simulation->miner.data();
+    blocks->parent = simulation->parent.data();
+    blocks->height = simulation->height.data();
+    blocks->arrival = simulation->arrival.data();
+    blocks->malicious = simulation->malicious.data();
+    blocks->in_chain = simulation->inChain.data();
+    return 0;
+}
+
+}
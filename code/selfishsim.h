@@ -0,0 +1,65 @@
+/* This file contains the C API of libselfishsim.so, the simulator as an in-process library */
+#ifndef SELFISHSIM_H
+#define SELFISHSIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SSIM_API_VERSION 1
+
+// One configured simulation. Every handle is independent, so several of them can run on different threads.
+typedef struct ssim_simulation ssim_simulation;
+
+// Metrics of the last run, the ratios are NaN when there is no ringmaster
+typedef struct {
+    double ratio_malicious_total;          // Malicious Blocks in Chain / Total Blocks in Longest Chain
+    double ratio_malicious_totalMalicious; // Malicious Blocks in Chain / Total Malicious Blocks
+    int32_t malicious_blocks_chain;
+    int32_t honest_blocks_chain;
+    int32_t total_malicious_blocks;
+    int32_t ringmaster;
+    int64_t events_processed;
+    double wall_time;
+} ssim_metrics;
+
+// The block tree of the ringmaster after the last run as columns of equal length, parents before children.
+// The arrays belong to the handle and stay valid until the next run or ssim_destroy.
+typedef struct {
+    int64_t count;
+    const int32_t* miner;      // Peer which mined the block
+    const int32_t* parent;     // Index of the parent block, -1 for the children of the genesis block
+    const int32_t* height;
+    const double* arrival;     // Time at which the ringmaster received the block
+    const uint8_t* malicious;  // 1 when the miner is a malicious peer
+    const uint8_t* in_chain;   // 1 when the block is on the longest chain of the ringmaster
+} ssim_blocks;
+
+int ssim_api_version(void);
+
+// The arguments of the command line, followed by the flags of ./run (for example "--seed", "7"). Returns NULL
+// when a flag is not known or the engine is not the event engine.
+ssim_simulation* ssim_create(int num_nodes, double malicious_percentage, double mean_transaction_time,
+                             double average_block_arrival_time, int get_request_timeout, int total_execution_time,
+                             int num_flags, const char* const* flags);
+void ssim_destroy(ssim_simulation* simulation);
+
+// Changes the seed of the next run
+void ssim_set_seed(ssim_simulation* simulation, uint64_t seed);
+
+// Runs the simulation, returns 0 on success. Nothing is printed and no log file is written.
+int ssim_run(ssim_simulation* simulation);
+
+// Message of the last failed call on this handle, empty when there was none
+const char* ssim_last_error(const ssim_simulation* simulation);
+
+int ssim_get_metrics(const ssim_simulation* simulation, ssim_metrics* metrics);
+int ssim_get_blocks(const ssim_simulation* simulation, ssim_blocks* blocks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+import ctypes
+import os
+import numpy as np
+
+# ctypes wrapper of libselfishsim.so (build it with `make libselfishsim.so`). The block columns are NumPy views of
+# the memory of the library, they stay valid until the next run of the same Simulation.
+
+API_VERSION = 1
+
+
+class Metrics(ctypes.Structure):
+    _fields_ = [
+        ("ratio_malicious_total", ctypes.c_double),
+        ("ratio_malicious_totalMalicious", ctypes.c_double),
+        ("malicious_blocks_chain", ctypes.c_int32),
+        ("honest_blocks_chain", ctypes.c_int32),
+        ("total_malicious_blocks", ctypes.c_int32),
+        ("ringmaster", ctypes.c_int32),
+        ("events_processed", ctypes.c_int64),
+        ("wall_time", ctypes.c_double),
+    ]
+
+
+class Blocks(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_int64),
+        ("miner", ctypes.POINTER(ctypes.c_int32)),
+        ("parent", ctypes.POINTER(ctypes.c_int32)),
+        ("height", ctypes.POINTER(ctypes.c_int32)),
+        ("arrival", ctypes.POINTER(ctypes.c_double)),
+        ("malicious", ctypes.POINTER(ctypes.c_uint8)),
+        ("in_chain", ctypes.POINTER(ctypes.c_uint8)),
+    ]
+
+
+def load_library(path=None):
+    path = path or os.path.join(os.path.dirname(os.path.abspath(__file__)), "libselfishsim.so")
+    lib = ctypes.CDLL(path)
+    lib.ssim_api_version.restype = ctypes.c_int
+    lib.ssim_create.restype = ctypes.c_void_p
+    lib.ssim_create.argtypes = [ctypes.c_int, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_int,
+                                ctypes.c_int, ctypes.c_int, ctypes.POINTER(ctypes.c_char_p)]
+    lib.ssim_destroy.argtypes = [ctypes.c_void_p]
+    lib.ssim_set_seed.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+    lib.ssim_run.restype = ctypes.c_int
+    lib.ssim_run.argtypes = [ctypes.c_void_p]
+    lib.ssim_last_error.restype = ctypes.c_char_p
+    lib.ssim_last_error.argtypes = [ctypes.c_void_p]
+    lib.ssim_get_metrics.argtypes = [ctypes.c_void_p, ctypes.POINTER(Metrics)]
+    lib.ssim_get_blocks.argtypes = [ctypes.c_void_p, ctypes.POINTER(Blocks)]
+    if lib.ssim_api_version() != API_VERSION:
+        raise RuntimeError(f"{path} has API version {lib.ssim_api_version()}, expected {API_VERSION}")
+    return lib
+
+
+_lib = None
+
+
+def library():
+    global _lib
+    if _lib is None:
+        _lib = load_library()
+    return _lib
+
+
+class Simulation:
+    """One configured simulation, the arguments and flags are the ones of ./run"""
+
+    def __init__(self, num_peer, percent_malicious, Ttx, Tk, get_timeout, total_time, flags=(), seed=None):
+        self.lib = library()
+        encoded = [str(flag).encode() for flag in flags]
+        argv = (ctypes.c_char_p * max(1, len(encoded)))(*encoded)
+        self.handle = self.lib.ssim_create(num_peer, percent_malicious, Ttx, Tk, get_timeout, total_time, len(encoded), argv)
+        if not self.handle:
+            raise ValueError(f"Invalid flags: {' '.join(map(str, flags))}")
+        if seed is not None:
+            self.lib.ssim_set_seed(self.handle, seed)
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            self.lib.ssim_destroy(self.handle)
+            self.handle = None
+
+    def run(self, seed=None):
+        if seed is not None:
+            self.lib.ssim_set_seed(self.handle, seed)
+        if self.lib.ssim_run(self.handle) != 0:
+            raise RuntimeError(self.lib.ssim_last_error(self.handle).decode())
+        return self
+
+    def metrics(self):
+        metrics = Metrics()
+        if self.lib.ssim_get_metrics(self.handle, ctypes.byref(metrics)) != 0:
+            raise RuntimeError("The simulation has not run yet")
+        return {name: getattr(metrics, name) for name, _ in Metrics._fields_}
+
+    def blocks(self):
+        # Zero copy views, copy them to keep them past the next run
+        blocks = Blocks()
+        if self.lib.ssim_get_blocks(self.handle, ctypes.byref(blocks)) != 0:
+            raise RuntimeError("The simulation has not run yet")
+        count = blocks.count
+        columns = {}
+        for name, _ in Blocks._fields_[1:]:
+            pointer = getattr(blocks, name)
+            columns[name] = np.ctypeslib.as_array(pointer, shape=(count,)) if count else np.zeros(0, dtype=pointer._type_)
+        return columns
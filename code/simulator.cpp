@@ -1,130 +1,514 @@
 #include "simulator.h"
+#include <barrier>
+#include <exception>
+#include <limits>
+#include <stdexcept>
 
-void Simulator::run() {
-    // This function is the main function that runs the simulation
-    for (int i = 0 ; i < num_nodes ; i++ ) {
-        // Create genesis block for each peer
-        peers[i]->createGenesisBlock();
-        peers[i]->blockchain->whether_sent_to_honest[genesisHash] = true;
+Simulator::~Simulator() {
+    for (Peer* peer : ctx.peers) delete peer; // Delete the peer objects
+}
+
+void Simulator::setup() {
+    // Create the peers, connect them and pick the ringmaster
+    if (ctx.whether_logging) clearLogFile(ctx.logDirectory); // Clear the previous messages from the log file
+    if (ctx.topologyFile != "") loadTopology(ctx, ctx.topologyFile); // The number of nodes and the malicious peers come from the topology file
+    for (int i = 0; i < ctx.num_nodes; i++) {
+        Peer* peer = new Peer(this, i);
+        ctx.peers.push_back(peer);
     }
-    for (int i = 0 ; i < num_nodes ; i ++ ) {
-        double interArrivalTime = getInterArrivalTime();
-        scheduleEvent(interArrivalTime, CREATE_TRANSACTION, i, -1, {}); // Schedule the first transaction for each peer
+    if (ctx.topologyFile != "") applyTopology(ctx);
+    else generateConnectedGraph(ctx);
+    vector<int> malicious_nodes;
+    for (int i = 0 ; i < ctx.num_nodes ; i ++){
+        if (ctx.peers[i]->isMalicious) malicious_nodes.push_back(i);
     }
-    for (int i = 0 ; i < num_nodes ; i ++) 
+    if (malicious_nodes.size()) 
     {
-        if (!peers[i]->isMalicious || i == ringMaster)
-        {
-            scheduleEvent(currentTime, MINING_START, i, -1, {}); // Schedule the first mining event
+        // Selecting the ring master and giving it the hash power of all malicious nodes
+        RandomStream ringMasterRng(ctx.seed, RINGMASTER_STREAM, RNG_TOPOLOGY);
+        int ringMasterIndex =  uniformRandom(ringMasterRng, 0, malicious_nodes.size() - 1);
+        ctx.ringMaster = malicious_nodes[ringMasterIndex];
+        ctx.peers[ctx.ringMaster]->hashingPower = ((double)malicious_nodes.size())/ctx.num_nodes;
+    }
+    if (ctx.num_observers >= 0) {
+        // Every honest peer except the observers only relays headers and blocks
+        vector<int> honest_nodes;
+        for (int i = 0 ; i < ctx.num_nodes ; i ++ ) {
+            if (!ctx.peers[i]->isMalicious) honest_nodes.push_back(i);
         }
+        RandomStream observersRng(ctx.seed, OBSERVERS_STREAM, RNG_TOPOLOGY);
+        shuffle(honest_nodes.begin(), honest_nodes.end(), observersRng);
+        for (int i = ctx.num_observers ; i < (int)honest_nodes.size() ; i ++ ) ctx.peers[honest_nodes[i]]->setRelayOnly();
     }
-    
-    while ( !eventQueue.empty() && currentTime <= totalExecutionTime ){
-        // Run the simulation until the event queue is empty
-        Event current = eventQueue.top();
-        if (debug && current.type != CREATE_TRANSACTION && current.type != TRANSACTION_SEND && current.type != TRANSACTION_RECEIVE && current.type != HANDLE_TIMEOUT) {
-            cout << current;
+}
+
+void Simulator::run() {
+    // This function is the main function that runs the simulation
+    createPartitions();
+    if (whether_restored) {
+        // The pending events of the checkpoint go to the partitions of their owners
+        for (Event& event : restoredEvents) pushEvent(partitions[partitionOf(event.owner())], move(event));
+        restoredEvents.clear();
+        for (Partition& partition : partitions) partition.currentTime = currentTime;
+    } else {
+        for (int i = 0 ; i < ctx.num_nodes ; i++ ) {
+            // Create genesis block for each peer
+            ctx.peers[i]->createGenesisBlock();
+            ctx.peers[i]->blockchain->whether_sent_to_honest[genesisHash] = true;
         }
-        eventQueue.pop();
-        currentTime = current.time;
-        handleEvent(current);
+        for (int i = 0 ; i < ctx.num_nodes ; i ++ ) {
+            if (ctx.peers[i]->isRelayOnly) continue; // Relay only peers do not create transactions, they have no balance to spend from
+            double interArrivalTime = getInterArrivalTime(i);
+            scheduleEvent(interArrivalTime, CREATE_TRANSACTION, i, -1, {}); // Schedule the first transaction for each peer
+        }
+        for (int i = 0 ; i < ctx.num_nodes ; i ++) 
+        {
+            if (!ctx.peers[i]->isMalicious || i == ctx.ringMaster)
+            {
+                scheduleEvent(currentTime, MINING_START, i, -1, {}); // Schedule the first mining event
+            }
+        }
+    }
+
+    if (ctx.trafficFile != "") {
+        trafficOut.open(ctx.trafficFile);
+        if (!trafficOut) throw runtime_error("Unable to write traffic file: " + ctx.trafficFile);
+        trafficOut << "time,event,link,messages,bytes\n";
     }
+    if (ctx.checkpointAt >= currentTime && ctx.checkpointAt <= ctx.totalExecutionTime) {
+        runUntil(ctx.checkpointAt, false);
+        saveCheckpoint(ctx.checkpointFile);
+    }
+    runUntil(ctx.totalExecutionTime, false);
 
-    if (debug) {
+    if (ctx.debug) {
         cout << "Starting post simulation broadcast" << endl;
     }
-    while (!eventQueue.empty()) eventQueue.pop();
-    currentTime = totalExecutionTime;
-    peers[ringMaster]->receivePrivateMessage("PRIVATE " + to_string(getBroadCastNumber()), ringMaster);
+    for (Partition& partition : partitions) {
+        while (!partition.eventQueue.empty()) popEvent(partition);
+        partition.currentTime = ctx.totalExecutionTime;
+    }
+    currentTime = ctx.totalExecutionTime;
+    if (ctx.ringMaster != -1) ctx.peers[ctx.ringMaster]->receivePrivateMessage("PRIVATE " + to_string(ctx.getBroadCastNumber()), ctx.ringMaster);
 
-    while ( !eventQueue.empty() ) {
-        Event current = eventQueue.top();
-        eventQueue.pop();
-        currentTime = current.time;
+    runUntil(numeric_limits<double>::infinity(), true);
+    eventsProcessed = countEventsProcessed();
+    // The last sample holds the post run broadcast too, like the totals of --stats and --traffic-edges
+    if (trafficOut.is_open()) writeTrafficSample(trafficOut, currentTime, countTraffic());
+}
+
+long long Simulator::countEventsProcessed() {
+    long long count = eventsBeforeRestore;
+    for (Partition& partition : partitions) count += partition.eventsProcessed;
+    return count;
+}
 
-        if (current.type == CREATE_TRANSACTION
+TrafficCounters Simulator::countTraffic() {
+    TrafficCounters total = trafficBeforeRestore;
+    for (Partition& partition : partitions) total.merge(partition.traffic);
+    return total;
+}
+
+void Simulator::checkTraffic(double time) {
+    // Append the cumulative counters to the traffic file when a sample is due
+    if (time < nextTrafficSample) return;
+    writeTrafficSample(trafficOut, time, countTraffic());
+    nextTrafficSample = time + ctx.trafficSampleInterval;
+}
+
+void Simulator::saveCheckpoint(const string& path) {
+    // Write the parameters that shaped the network, the peers and the pending events. Every event up to the
+    // checkpoint time has been handled and the partitions have no messages in flight.
+    CheckpointWriter out(path);
+    out.write(checkpointMagic);
+    out.write(ctx.num_nodes);
+    out.write(ctx.malicious_percentage);
+    out.write(ctx.meanTransactionTime);
+    out.write(ctx.averageBlockArrivalTime);
+    out.write(ctx.seed);
+    out.write(ctx.current_block_id);
+    out.write(ctx.broadcastnumber);
+    out.write(ctx.ringMaster);
+    out.write(ctx.honestLinks);
+    out.write(ctx.overlayLinks);
+    out.write(currentTime);
+    out.write(countEventsProcessed());
+    out.write(nextMemorySample);
+    out.write(countTraffic());
+    out.write(nextTrafficSample);
+    out.write(*ctx.transactions);
+    for (Peer* peer : ctx.peers) peer->saveState(out);
+    size_t pendingEvents = 0;
+    for (Partition& partition : partitions) pendingEvents += partition.eventQueue.size();
+    out.write(pendingEvents);
+    for (Partition& partition : partitions) {
+        for (priority_queue<Event> pending = partition.eventQueue; !pending.empty(); pending.pop()) out.write(pending.top());
+    }
+    out.close();
+    cout << "Checkpoint written to " << path << " at time " << currentTime << endl;
+}
+
+void Simulator::restoreCheckpoint(const string& path) {
+    // Used instead of setup. The parameters of the network come from the checkpoint, the timeout, the
+    // execution time and the flags from the command line.
+    CheckpointReader in(path);
+    char magic[sizeof(checkpointMagic)];
+    in.read(magic);
+    if (memcmp(magic, checkpointMagic, sizeof(magic)) != 0) throw runtime_error(path + " is not a checkpoint file");
+    in.read(ctx.num_nodes);
+    in.read(ctx.malicious_percentage);
+    in.read(ctx.meanTransactionTime);
+    in.read(ctx.averageBlockArrivalTime);
+    in.read(ctx.seed);
+    in.read(ctx.current_block_id);
+    in.read(ctx.broadcastnumber);
+    in.read(ctx.ringMaster);
+    in.read(ctx.honestLinks);
+    in.read(ctx.overlayLinks);
+    in.read(currentTime);
+    in.read(eventsBeforeRestore);
+    in.read(nextMemorySample);
+    in.read(trafficBeforeRestore);
+    in.read(nextTrafficSample);
+    if (ctx.whether_logging) clearLogFile(ctx.logDirectory);
+    for (int i = 0; i < ctx.num_nodes; i++) ctx.peers.push_back(new Peer(this, i));
+    in.read(*ctx.transactions);
+    for (Peer* peer : ctx.peers) peer->loadState(in);
+    restoredEvents.resize(in.readSize(), Event(0, CREATE_TRANSACTION, 0, -1, {}));
+    for (Event& event : restoredEvents) in.read(event);
+    whether_restored = true;
+    if (ctx.forkSeed >= 0) {
+        for (Peer* peer : ctx.peers) {
+            peer->latencyRng.reseed(ctx.forkSeed);
+            peer->miningRng.reseed(ctx.forkSeed);
+            peer->transactionRng.reseed(ctx.forkSeed);
+        }
+    }
+    if (ctx.enable_countermeasure) {
+        // The countermeasure may be switched on for the part of the run after the checkpoint
+        for (Peer* peer : ctx.peers) {
+            for (auto& [nid, neighbour] : peer->neighbours) {
+                if (peer->trustScore.count(nid)) continue;
+                peer->resetScore(nid);
+                peer->banCount[nid] = 0;
+            }
+        }
+    }
+}
+
+void Simulator::createPartitions() {
+    // Split the peers into one partition per thread. Every message between two peers takes at least the
+    // smallest propagation delay, so the partitions can run that far ahead of each other without missing one.
+    lookahead = min(MIN_PROPAGATION_DELAY, MIN_OVERLAY_PROPAGATION_DELAY);
+    for (const LinkTable* links : {&ctx.honestLinks, &ctx.overlayLinks}) {
+        for (const LinkParams& link : links->params) lookahead = min(lookahead, (double)link.propagationDelay);
+    }
+    lookahead /= 1e3; // converting to seconds
+    int num_partitions = max(1, min(ctx.num_threads, ctx.num_nodes));
+    if (num_partitions > 1 && lookahead <= 0) {
+        cout << "Links without propagation delay leave no lookahead, running on a single thread" << endl;
+        num_partitions = 1;
+    }
+    partitions.assign(num_partitions, Partition());
+    for (int i = 0 ; i < num_partitions ; i ++ ) {
+        partitions[i].index = i;
+        partitions[i].outbox.resize(num_partitions);
+    }
+}
+
+void Simulator::runUntil(double endTime, bool whether_post_run) {
+    // Handle the events up to endTime. The parallel engine moves all the partitions forward in windows of the
+    // lookahead: a message sent inside a window arrives after its end and is delivered before the next window.
+    if (partitions.size() == 1) {
+        processPartition(partitions[0], numeric_limits<double>::infinity(), endTime, whether_post_run);
+        currentTime = partitions[0].currentTime;
+        return;
+    }
+    bool whether_track_memory = !whether_post_run && (ctx.whether_stats || ctx.memoryBudgetMB > 0);
+    bool whether_sample_traffic = !whether_post_run && trafficOut.is_open();
+    exception_ptr failure;
+    double windowEnd = 0;
+    bool done = false;
+    auto nextWindow = [&]() noexcept {
+        // Runs on one thread once every partition has collected its mail
+        double earliest = numeric_limits<double>::infinity();
+        for (Partition& partition : partitions) {
+            if (!partition.eventQueue.empty()) earliest = min(earliest, partition.eventQueue.top().time);
+        }
+        done = earliest == numeric_limits<double>::infinity() || earliest > endTime;
+        if (!done) currentTime = max(currentTime, earliest);
+        if (!done && whether_sample_traffic) checkTraffic(currentTime);
+        if (!done && whether_track_memory) {
+            try {
+                checkMemory(currentTime);
+            } catch (...) {
+                failure = current_exception();
+                done = true;
+            }
+        }
+        windowEnd = earliest + lookahead;
+    };
+    nextWindow();
+    barrier<> processed(partitions.size());
+    barrier collected(partitions.size(), nextWindow);
+    whether_exchanging = true;
+    parallelFor(partitions.size(), partitions.size(), [&](int begin, int) {
+        Partition& partition = partitions[begin]; // One partition per thread
+        while (!done) {
+            processPartition(partition, windowEnd, endTime, whether_post_run);
+            processed.arrive_and_wait();
+            collectMail(partition);
+            collected.arrive_and_wait();
+        }
+    });
+    whether_exchanging = false;
+    for (Partition& partition : partitions) currentTime = max(currentTime, partition.currentTime);
+    if (failure) rethrow_exception(failure);
+}
+
+void Simulator::processPartition(Partition& partition, double windowEnd, double endTime, bool whether_post_run) {
+    // Handle the events of one partition that fall before windowEnd
+    bool whether_track_memory = !whether_post_run && partitions.size() == 1 && (ctx.whether_stats || ctx.memoryBudgetMB > 0);
+    bool whether_sample_traffic = !whether_post_run && partitions.size() == 1 && trafficOut.is_open();
+    while (!partition.eventQueue.empty() && partition.eventQueue.top().time < windowEnd && partition.eventQueue.top().time <= endTime) {
+        Event current = popEvent(partition);
+        partition.currentTime = current.time;
+
+        if (whether_post_run && (current.type == CREATE_TRANSACTION
             || current.type == TRANSACTION_SEND
             || current.type == TRANSACTION_RECEIVE
             || current.type == MINING_START
-            || current.type == MINING_END) {
+            || current.type == MINING_END)) {
             continue; // Skip these events in the final output
         }
 
-        if (debug && current.type != CREATE_TRANSACTION && current.type != TRANSACTION_SEND && current.type != TRANSACTION_RECEIVE && current.type != HANDLE_TIMEOUT) {
+        if (ctx.debug && current.type != CREATE_TRANSACTION && current.type != TRANSACTION_SEND && current.type != TRANSACTION_RECEIVE && current.type != HANDLE_TIMEOUT) {
             cout << current;
         }
+        handleEvent(current, partition);
+        partition.eventsProcessed++;
+        if (whether_sample_traffic) checkTraffic(partition.currentTime);
+        if (whether_track_memory) checkMemory(partition.currentTime);
+    }
+}
+
+void Simulator::collectMail(Partition& partition) {
+    // Move the messages the other partitions sent to this one into its event queue
+    for (Partition& sender : partitions) {
+        for (Event& event : sender.outbox[partition.index]) pushEvent(partition, move(event));
+        sender.outbox[partition.index].clear();
+    }
+}
 
-        handleEvent(current);
+void Simulator::checkMemory(double time) {
+    // Take a memory sample when one is due and stop the run if it is over the budget
+    if (time < nextMemorySample) return;
+    currentTime = time;
+    MemoryUsage usage = sampleMemory();
+    nextMemorySample = time + ctx.memorySampleInterval;
+    if (memoryBudgetExceeded(ctx, usage)) {
+        printMemoryUsage(usage, "Current");
+        throw runtime_error("Memory budget of " + to_string(ctx.memoryBudgetMB) + " MB exceeded at time " + to_string(time));
     }
 }
 
-void Simulator::handleEvent( Event& event ) {
+void Simulator::handleEvent(Event& event, Partition& partition) {
     // This function handles the event based on the event type
     double newTime;
     string current_mined_hash;
     switch (event.type) {
         case MINING_START:
-            current_mined_hash = peers[event.sourcePeer]->mining_start();
-            newTime = currentTime + peers[event.sourcePeer]->getBlockInterArrivalTime();
-            scheduleEvent(newTime, MINING_END, event.sourcePeer, -1, current_mined_hash); // Schedule the mining end event 
+            current_mined_hash = ctx.peers[event.sourcePeer]->mining_start();
+            newTime = partition.currentTime + ctx.peers[event.sourcePeer]->getBlockInterArrivalTime();
+            scheduleEvent(newTime, MINING_END, event.sourcePeer, -1, move(current_mined_hash)); // Schedule the mining end event 
             break;
         case MINING_END:
-            peers[event.sourcePeer]->mining_end(get<string>(event.data));
+            ctx.peers[event.sourcePeer]->mining_end(get<string>(event.data));
             break;
         case CREATE_TRANSACTION:
-            peers[event.sourcePeer]->generateTransaction();
-            newTime = currentTime + getInterArrivalTime();
-            scheduleEvent(newTime, CREATE_TRANSACTION, event.sourcePeer, -1, event.data); // Schedule the next transaction
+            ctx.peers[event.sourcePeer]->generateTransaction();
+            newTime = partition.currentTime + getInterArrivalTime(event.sourcePeer);
+            scheduleEvent(newTime, CREATE_TRANSACTION, event.sourcePeer, -1, move(event.data)); // Schedule the next transaction
             break;
         case TRANSACTION_SEND:
-            newTime = currentTime + calculateLatency(!peers[event.sourcePeer]->isMalicious, !peers[event.targetPeer]->isMalicious, get<Transaction>(event.data).getSize(), event.whether_overlay);
-            scheduleEvent(newTime, TRANSACTION_RECEIVE, event.sourcePeer, event.targetPeer, event.data); // Schedule the transaction receive event
+            newTime = partition.currentTime + messageLatency(event, TransactionSize);
+            scheduleEvent(newTime, TRANSACTION_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data)); // Schedule the transaction receive event
             break;
         case TRANSACTION_RECEIVE:
-            peers[event.targetPeer]->receiveTransaction(get<Transaction>(event.data), event.sourcePeer); // Receive the transaction
+            ctx.peers[event.targetPeer]->receiveTransaction(get<TxIndex>(event.data), event.sourcePeer); // Receive the transaction
             break;
         case BLOCK_SEND:
-            newTime = currentTime + calculateLatency(!peers[event.sourcePeer]->isMalicious, !peers[event.targetPeer]->isMalicious, get<Block>(event.data).getBlocksize(), event.whether_overlay);
-            scheduleEvent(newTime, BLOCK_RECEIVE, event.sourcePeer, event.targetPeer, event.data);
+            if (ctx.blockRelay == COMPACT_BLOCK_RELAY) newTime = partition.currentTime + messageLatency(event, get<Block>(event.data).getCompactSize());
+            else newTime = partition.currentTime + messageLatency(event, get<Block>(event.data).getBlocksize());
+            scheduleEvent(newTime, BLOCK_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data));
             break;
         case BLOCK_RECEIVE:
-            peers[event.targetPeer]->receiveBlock(get<Block>(event.data), event.sourcePeer);
+            if (ctx.blockRelay == COMPACT_BLOCK_RELAY) ctx.peers[event.targetPeer]->receiveCompactBlock(move(get<Block>(event.data)), event.sourcePeer);
+            else ctx.peers[event.targetPeer]->receiveBlock(move(get<Block>(event.data)), event.sourcePeer);
+            break;
+        case GET_STAGGER:
+            ctx.peers[event.sourcePeer]->handleStagger(get<string>(event.data));
+            break;
+        case BLOCK_VALIDATION:
+            ctx.peers[event.sourcePeer]->finishValidation(get<string>(event.data));
+            break;
+        case BLOCK_TRANSACTIONS_REQUEST_SEND:
+            newTime = partition.currentTime + messageLatency(event, get<vector<TxIndex>>(event.data).size() * shortTransactionIDSize);
+            scheduleEvent(newTime, BLOCK_TRANSACTIONS_REQUEST_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data), event.whether_overlay);
+            break;
+        case BLOCK_TRANSACTIONS_REQUEST_RECEIVE:
+            ctx.peers[event.targetPeer]->receiveBlockTransactionRequest(get<vector<TxIndex>>(event.data), event.sourcePeer);
+            break;
+        case BLOCK_TRANSACTIONS_SEND:
+            newTime = partition.currentTime + messageLatency(event, get<vector<TxIndex>>(event.data).size() * TransactionSize);
+            scheduleEvent(newTime, BLOCK_TRANSACTIONS_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data), event.whether_overlay);
+            break;
+        case BLOCK_TRANSACTIONS_RECEIVE:
+            ctx.peers[event.targetPeer]->receiveBlockTransactions(get<vector<TxIndex>>(event.data), event.sourcePeer);
             break;
         case GET_SEND:
-            newTime = currentTime + calculateLatency(!peers[event.sourcePeer]->isMalicious, !peers[event.targetPeer]->isMalicious, getSize, event.whether_overlay);
+            newTime = partition.currentTime + messageLatency(event, getSize);
             scheduleEvent(newTime, GET_RECEIVE, event.sourcePeer, event.targetPeer, event.data);
-            newTime = currentTime + GetRequestTimeout;
-            scheduleEvent(newTime, HANDLE_TIMEOUT, event.sourcePeer, event.targetPeer, event.data);
+            newTime = partition.currentTime + ctx.GetRequestTimeout;
+            scheduleEvent(newTime, HANDLE_TIMEOUT, event.sourcePeer, event.targetPeer, move(event.data));
             break;
         case GET_RECEIVE:
-            peers[event.targetPeer]->receiveGetRequest(get<string>(event.data), event.sourcePeer);
+            ctx.peers[event.targetPeer]->receiveGetRequest(get<string>(event.data), event.sourcePeer);
             break;
         case HASH_SEND:
-            newTime = currentTime + calculateLatency(!peers[event.sourcePeer]->isMalicious, !peers[event.targetPeer]->isMalicious, hashSize, event.whether_overlay);
-            scheduleEvent(newTime, HASH_RECEIVE, event.sourcePeer, event.targetPeer, event.data);
+            newTime = partition.currentTime + messageLatency(event, hashSize);
+            scheduleEvent(newTime, HASH_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data));
             break;
         case HASH_RECEIVE:
-            peers[event.targetPeer]->receiveHash(get<string>(event.data), event.sourcePeer);
+            ctx.peers[event.targetPeer]->receiveHash(get<string>(event.data), event.sourcePeer);
             break;
         case HANDLE_TIMEOUT:
-            peers[event.sourcePeer]->handleTimeout(get<string>(event.data));
+            ctx.peers[event.sourcePeer]->handleTimeout(get<string>(event.data), event.targetPeer);
             break;
         case PRIVATE_MESSAGE_RECEIVE:
-            peers[event.targetPeer]->receivePrivateMessage(get<string>(event.data), event.sourcePeer);
+            ctx.peers[event.targetPeer]->receivePrivateMessage(get<string>(event.data), event.sourcePeer);
             break;
         case PRIVATE_MESSAGE_SEND:
-            newTime = currentTime + calculateLatency(!peers[event.sourcePeer]->isMalicious, !peers[event.targetPeer]->isMalicious, broadcastPrivateChainSize, event.whether_overlay);
-            scheduleEvent(newTime, PRIVATE_MESSAGE_RECEIVE, event.sourcePeer, event.targetPeer, event.data);
+            newTime = partition.currentTime + messageLatency(event, broadcastPrivateChainSize);
+            scheduleEvent(newTime, PRIVATE_MESSAGE_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data));
+            break;
+        case INVENTORY_TRICKLE:
+            ctx.peers[event.sourcePeer]->sendInventory();
+            break;
+        case INVENTORY_SEND:
+            newTime = partition.currentTime + messageLatency(event, get<vector<TxIndex>>(event.data).size() * inventoryEntrySize);
+            scheduleEvent(newTime, INVENTORY_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data), event.whether_overlay);
+            break;
+        case INVENTORY_RECEIVE:
+            ctx.peers[event.targetPeer]->receiveInventory(get<vector<TxIndex>>(event.data), event.sourcePeer);
+            break;
+        case GETDATA_SEND:
+            newTime = partition.currentTime + messageLatency(event, get<vector<TxIndex>>(event.data).size() * inventoryEntrySize);
+            scheduleEvent(newTime, GETDATA_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data), event.whether_overlay);
             break;
+        case GETDATA_RECEIVE:
+            ctx.peers[event.targetPeer]->receiveTransactionRequest(get<vector<TxIndex>>(event.data), event.sourcePeer);
+            break;
+        case TRANSACTION_BATCH_SEND:
+            newTime = partition.currentTime + messageLatency(event, get<vector<TxIndex>>(event.data).size() * TransactionSize);
+            scheduleEvent(newTime, TRANSACTION_BATCH_RECEIVE, event.sourcePeer, event.targetPeer, move(event.data), event.whether_overlay);
+            break;
+        case TRANSACTION_BATCH_RECEIVE:
+            ctx.peers[event.targetPeer]->receiveTransactionBatch(get<vector<TxIndex>>(event.data), event.sourcePeer);
+            break;
+        default:
+            throw logic_error("Unhandled event type " + eventTypeName(event.type));
     }
 }
 
 void Simulator::scheduleEvent(double time, EventType type, int sourcePeer, int targetPeer, EventData data, bool whether_overlay) {
-    Event newEvent = Event(time, type, sourcePeer, targetPeer, data, whether_overlay);
-    // Push the event to the event queue
-    eventQueue.push(newEvent);
+    // The event is scheduled by the partition of its sender. Events for a peer of another partition wait in the
+    // outbox until the end of the window when the partitions run in parallel.
+    Event newEvent(time, type, sourcePeer, targetPeer, move(data), whether_overlay);
+    // The sequence only depends on the sender, so events at the same time are handled in the same order for
+    // any number of partitions
+    Partition& from = partitions[partitionOf(sourcePeer)];
+    newEvent.sequence = ctx.peers[sourcePeer]->nextEventSequence++ * ctx.num_nodes + sourcePeer;
+    int to = partitionOf(newEvent.owner());
+    if (whether_exchanging && to != from.index) from.outbox[to].push_back(move(newEvent));
+    else pushEvent(partitions[to], move(newEvent));
+}
+
+double Simulator::messageLatency(Event& event, int messageLength) {
+    // Use the parameters of the link when a topology file was loaded, otherwise derive them from the peer types
+    Peer* source = ctx.peers[event.sourcePeer];
+    if (!ctx.honestLinks.empty()) {
+        const LinkParams* link = (event.whether_overlay ? ctx.overlayLinks : ctx.honestLinks).find(event.sourcePeer, event.targetPeer);
+        if (link) {
+            countMessage(event, messageLength, link->bandwidth);
+            return linkLatency(source->latencyRng, *link, messageLength) + linkQueueDelay(event, messageLength, link->bandwidth);
+        }
+    }
+    bool isSlowI = !source->isMalicious, isSlowJ = !ctx.peers[event.targetPeer]->isMalicious;
+    double bandwidth = !isSlowI && !isSlowJ ? FAST_LINK_SPEED : SLOW_LINK_SPEED;
+    countMessage(event, messageLength, bandwidth);
+    double latency = calculateLatency(source->latencyRng, isSlowI, isSlowJ, messageLength, event.whether_overlay);
+    return latency + linkQueueDelay(event, messageLength, bandwidth);
+}
+
+void Simulator::countMessage(Event& event, int messageLength, double bandwidth) {
+    // The send events run in the partition of the sender, so its counters need no locking
+    LinkClass link = event.whether_overlay ? OVERLAY_LINK : bandwidth >= FAST_LINK_SPEED ? FAST_LINK : SLOW_LINK;
+    partitions[partitionOf(event.sourcePeer)].traffic.add(event.type, link, messageLength);
+    if (ctx.trafficEdgesFile != "") {
+        pair<long long, long long>& edge = ctx.peers[event.sourcePeer]->edgeTraffic[event.targetPeer * 2 + event.whether_overlay];
+        edge.first++;
+        edge.second += messageLength / 8;
+    }
 }
 
-double Simulator::getInterArrivalTime() { 
-    return exponentialRandom(meanTime); 
-}
\ No newline at end of file
+double Simulator::linkQueueDelay(Event& event, int messageLength, double bandwidth) {
+    // Time the message waits for the earlier messages on the uplink or the edge of the sender to go out
+    if (ctx.linkModel == INDEPENDENT_LINKS) return 0;
+    Peer* source = ctx.peers[event.sourcePeer];
+    LinkQueue& link = ctx.linkModel == UPLINK_QUEUE ? source->uplinkQueue : source->edgeQueues[event.targetPeer * 2 + event.whether_overlay];
+    double now = partitions[partitionOf(event.sourcePeer)].currentTime;
+    // With --block-priority the block traffic only waits for other block traffic
+    bool whether_block_traffic = ctx.blockPriority && event.type != TRANSACTION_SEND && event.type != INVENTORY_SEND && event.type != GETDATA_SEND && event.type != TRANSACTION_BATCH_SEND;
+    double start = max(now, whether_block_traffic ? link.blockBusyUntil : link.busyUntil);
+    double end = start + messageLength / bandwidth;
+    if (whether_block_traffic) link.blockBusyUntil = end;
+    if (start < link.busyUntil) {
+        // The block cut ahead of queued transaction traffic. The transaction messages already scheduled keep
+        // their times and overlap with the block, so the link carries more than its bandwidth while they do. The
+        // end of the transaction traffic is pushed back by the time the block takes, which the next ones wait for.
+        link.busyUntil += end - start;
+    } else {
+        link.busyUntil = end;
+    }
+    source->queuedMessages++;
+    source->queueingDelay += start - now;
+    return start - now;
+}
+
+void Simulator::pushEvent(Partition& partition, Event&& event) {
+    partition.eventQueueBytes += estimateEventBytes(event);
+    partition.eventQueue.push(move(event));
+}
+
+Event Simulator::popEvent(Partition& partition) {
+    // Remove the earliest event from the event queue and return it
+    // The top is about to be popped, so its data can be moved out instead of copied
+    Event current = move(const_cast<Event&>(partition.eventQueue.top()));
+    partition.eventQueue.pop();
+    partition.eventQueueBytes -= estimateEventBytes(current);
+    return current;
+}
+
+MemoryUsage Simulator::sampleMemory() {
+    // Take a memory sample and remember it if it is the largest so far
+    long long eventQueueBytes = 0;
+    for (Partition& partition : partitions) eventQueueBytes += partition.eventQueueBytes;
+    MemoryUsage usage = sampleMemoryUsage(ctx, currentTime, eventQueueBytes);
+    if (usage.total() >= peakMemoryUsage.total()) peakMemoryUsage = usage;
+    return usage;
+}
+
+double Simulator::getInterArrivalTime(int peer) { 
+    return exponentialRandom(ctx.peers[peer]->transactionRng, ctx.meanTransactionTime); 
+}
@@ -10,6 +10,12 @@
 #include "block.h"
 #include "event.h"
 #include "helper.h"
+#include "memory.h"
+#include "traffic.h"
+#include "topology.h"
+#include "context.h"
+#include "checkpoint.h"
+#include "mempool.h"
 #include <iostream>
 #include <fstream>
 #include <chrono>
@@ -18,32 +24,74 @@ using namespace std;
 class Peer;  // Forward declaration
 
 
-// Referring from main.cpp
-extern int num_nodes;
-extern vector<Peer*> peers;
-extern int totalExecutionTime;
+// Referring from constants.cpp
 extern const int getSize;
-extern int GetRequestTimeout;
 extern const int hashSize;
-extern int ringMaster;
 extern const int broadcastPrivateChainSize;
-extern bool debug;
+extern const int inventoryEntrySize;
+
+// The events and the clock of one group of peers. The sequential engine has a single partition, the parallel
+// engine gives every thread its own partition and hands messages between partitions over through the outboxes.
+struct Partition {
+    int index = 0;
+    priority_queue<Event> eventQueue;
+    double currentTime = 0.0;
+    long long eventsProcessed = 0;
+    long long eventQueueBytes = 0; // Estimated memory held by the pending events
+    TrafficCounters traffic;       // Messages sent by the peers of the partition
+    vector<vector<Event>> outbox;  // Messages for the peers of the other partitions, indexed by partition
+};
 
 class Simulator {
 public:
-    Simulator(double Time) {
-        meanTime = Time;
+    Simulator(const SimulationContext& context) : ctx(context), balanceCache(transactionTable) {
         currentTime = 0.0;
+        partitions.resize(1);
+        ctx.transactions = &transactionTable;
+        ctx.balances = &balanceCache;
     }
+    ~Simulator();
+    SimulationContext ctx; // All the state of this simulation outside of the peers
+    void setup();
+    void restoreCheckpoint(const string& path);
     void run();            
     double getCurrentTime() { return currentTime; }
+    double getCurrentTime(int peer) { return partitions[partitionOf(peer)].currentTime; }
     void scheduleEvent(double time, EventType type, int sourcePeer, int targetPeer, EventData txn, bool whether_overlay = false);
-    double getInterArrivalTime();
-    double meanTime;       
+    double getInterArrivalTime(int peer);
+    long long eventsProcessed = 0; // Number of events handled, reported with --stats
+    MemoryUsage peakMemoryUsage;   // Largest memory sample taken during the run
+    MemoryUsage sampleMemory();
+    TrafficCounters countTraffic();
 private:
-    priority_queue<Event> eventQueue; 
-    double currentTime;                   
-    void handleEvent(Event& event);  
+    TransactionTable transactionTable; // Every transaction of the run, referred to by index from the peers and events
+    BalanceCache balanceCache;         // Balances at the blocks, shared by the mempools of the peers
+    vector<Partition> partitions;
+    double currentTime;            // Lower bound on the clocks of all the partitions
+    double lookahead = 0.0;        // Smallest latency of a message between two peers, in seconds
+    bool whether_exchanging = false; // Set while the partitions run on their own threads
+    double nextMemorySample = 0;
+    bool whether_restored = false;
+    vector<Event> restoredEvents;  // Pending events of the checkpoint until run hands them to the partitions
+    long long eventsBeforeRestore = 0;
+    TrafficCounters trafficBeforeRestore;
+    double nextTrafficSample = 0;
+    ofstream trafficOut;           // Periodic traffic samples with --traffic-out
+    void checkTraffic(double time);
+    long long countEventsProcessed();
+    void saveCheckpoint(const string& path);
+    int partitionOf(int peer) { return (long long)peer * partitions.size() / max(1, ctx.num_nodes); }
+    void createPartitions();
+    void runUntil(double endTime, bool whether_post_run);
+    void processPartition(Partition& partition, double windowEnd, double endTime, bool whether_post_run);
+    void collectMail(Partition& partition);
+    void checkMemory(double time);
+    void handleEvent(Event& event, Partition& partition);  
+    void pushEvent(Partition& partition, Event&& event);
+    Event popEvent(Partition& partition);
+    double messageLatency(Event& event, int messageLength);
+    double linkQueueDelay(Event& event, int messageLength, double bandwidth);
+    void countMessage(Event& event, int messageLength, double bandwidth);
 };
 
 #endif 
@@ -0,0 +1,148 @@
+#include "topology.h"
+#include "helper.h"
+#include "peer.h"
+#include "context.h"
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void LinkTable::build(int num_vertices, const TopologyEdge* edges, uint32_t count) {
+    // Counting sort of both directions of every edge by their source peer
+    offsets.assign(num_vertices + 1, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        offsets[edges[i].u + 1]++;
+        offsets[edges[i].v + 1]++;
+    }
+    for (int i = 0; i < num_vertices; i++) offsets[i + 1] += offsets[i];
+    targets.resize(offsets[num_vertices]);
+    params.resize(offsets[num_vertices]);
+    vector<int> next(offsets.begin(), offsets.end() - 1);
+    for (uint32_t i = 0; i < count; i++) {
+        LinkParams link = {edges[i].bandwidth, edges[i].propagationDelay};
+        targets[next[edges[i].u]] = edges[i].v;
+        params[next[edges[i].u]++] = link;
+        targets[next[edges[i].v]] = edges[i].u;
+        params[next[edges[i].v]++] = link;
+    }
+    for (int u = 0; u < num_vertices; u++) {
+        // Sort each row so that find can binary search it
+        vector<pair<int, LinkParams>> row;
+        for (int k = offsets[u]; k < offsets[u + 1]; k++) row.emplace_back(targets[k], params[k]);
+        sort(row.begin(), row.end(), [](auto& a, auto& b) { return a.first < b.first; });
+        for (int k = 0; k < (int)row.size(); k++) {
+            targets[offsets[u] + k] = row[k].first;
+            params[offsets[u] + k] = row[k].second;
+        }
+    }
+}
+
+const LinkParams* LinkTable::find(int u, int v) const {
+    if (u < 0 || u + 1 >= (int)offsets.size()) return nullptr;
+    auto begin = targets.begin() + offsets[u], end = targets.begin() + offsets[u + 1];
+    auto it = lower_bound(begin, end, v);
+    if (it == end || *it != v) return nullptr;
+    return &params[it - targets.begin()];
+}
+
+long long LinkTable::bytes() const {
+    return offsets.capacity() * sizeof(int) + targets.capacity() * sizeof(int) + params.capacity() * sizeof(LinkParams);
+}
+
+void loadTopology(SimulationContext& ctx, const string& path) {
+    // Map the topology file into memory and build the link tables from it
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("Unable to open topology file: " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw runtime_error("Unable to read the size of topology file: " + path);
+    }
+    size_t size = info.st_size;
+    if (size < sizeof(TopologyFileHeader)) {
+        close(fd);
+        throw runtime_error("Topology file is too small: " + path);
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) throw runtime_error("Unable to map topology file: " + path);
+
+    const char* data = (const char*)mapped;
+    TopologyFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    size_t expected = sizeof(TopologyFileHeader) + header.num_malicious * sizeof(uint32_t) + ((size_t)header.num_honest_edges + header.num_overlay_edges) * sizeof(TopologyEdge);
+    if (memcmp(header.magic, topologyMagic, sizeof(topologyMagic)) != 0 || size != expected) {
+        munmap(mapped, size);
+        throw runtime_error("Not a valid topology file: " + path);
+    }
+    const uint32_t* malicious = (const uint32_t*)(data + sizeof(TopologyFileHeader));
+    const TopologyEdge* honestEdges = (const TopologyEdge*)(malicious + header.num_malicious);
+    const TopologyEdge* overlayEdges = honestEdges + header.num_honest_edges;
+    vector<bool> whether_malicious(header.num_nodes);
+    for (uint32_t i = 0; i < header.num_malicious; i++) {
+        if (malicious[i] >= header.num_nodes) {
+            uint32_t id = malicious[i];
+            munmap(mapped, size);
+            throw runtime_error("Invalid malicious peer " + to_string(id) + " in topology file: " + path);
+        }
+        whether_malicious[malicious[i]] = true;
+    }
+    auto checkEdges = [&](const TopologyEdge* edges, uint32_t count, bool overlay) {
+        // A delay that is not positive would schedule messages in the past and break the lookahead of the partitions
+        for (uint32_t i = 0; i < count; i++) {
+            const TopologyEdge& edge = edges[i];
+            bool valid = edge.u < header.num_nodes && edge.v < header.num_nodes && edge.u != edge.v;
+            valid = valid && isfinite(edge.bandwidth) && edge.bandwidth > 0 && isfinite(edge.propagationDelay) && edge.propagationDelay > 0;
+            valid = valid && (!overlay || (whether_malicious[edge.u] && whether_malicious[edge.v]));
+            if (!valid) {
+                munmap(mapped, size);
+                throw runtime_error("Invalid " + string(overlay ? "overlay" : "honest") + " edge " + to_string(i) + " in topology file: " + path);
+            }
+        }
+    };
+    checkEdges(honestEdges, header.num_honest_edges, false);
+    checkEdges(overlayEdges, header.num_overlay_edges, true);
+
+    ctx.num_nodes = header.num_nodes;
+    ctx.topologyMaliciousPeers.assign(malicious, malicious + header.num_malicious);
+    ctx.malicious_percentage = ctx.num_nodes ? 100.0 * header.num_malicious / ctx.num_nodes : 0;
+    ctx.honestLinks.build(ctx.num_nodes, honestEdges, header.num_honest_edges);
+    ctx.overlayLinks.build(ctx.num_nodes, overlayEdges, header.num_overlay_edges);
+    munmap(mapped, size);
+}
+
+void applyTopology(SimulationContext& ctx) {
+    // Connect the peers according to the loaded link tables, this replaces generateConnectedGraph
+    vector<Peer*>& peers = ctx.peers;
+    const LinkTable& honestLinks = ctx.honestLinks;
+    const LinkTable& overlayLinks = ctx.overlayLinks;
+    for (int id : ctx.topologyMaliciousPeers) peers[id]->isMalicious = true;
+    parallelFor(ctx.num_nodes, ctx.num_threads, [&](int begin, int end) {
+        for (int peer1 = begin; peer1 < end; peer1++) {
+            for (int k = honestLinks.offsets[peer1]; k < honestLinks.offsets[peer1 + 1]; k++) {
+                int peer2 = honestLinks.targets[k];
+                peers[peer1]->neighbours[peer2] = peers[peer2];
+                if (ctx.enable_countermeasure) {
+                    peers[peer1]->trustScore[peer2] = maxTrustScore;
+                    peers[peer1]->pastAttempts[peer2] = pair<int, int>(1, 1);
+                    peers[peer1]->banCount[peer2] = 0;
+                }
+            }
+            for (int k = overlayLinks.offsets[peer1]; k < overlayLinks.offsets[peer1 + 1]; k++) {
+                int peer2 = overlayLinks.targets[k];
+                peers[peer1]->malicious_neighbours[peer2] = peers[peer2];
+            }
+            peers[peer1]->setHashingPower();
+        }
+    });
+}
+
+double linkLatency(RandomStream& gen, const LinkParams& link, int messageLength) {
+    // Same model as calculateLatency, with the link speed and propagation delay fixed per link
+    double meanQueuingDelay = MEAN_QUEUING_DELAY_FACTOR / link.bandwidth;
+    double dij = exponentialRandom(gen, meanQueuingDelay);
+    double latency = link.propagationDelay + ((double)messageLength / link.bandwidth) * 1e3 + dij * 1e3; // converting to milliseconds
+    return latency / 1e3;
+}
@@ -0,0 +1,53 @@
+/* This file contains the loader for external network topologies with per link parameters */
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "rng.h"
+using namespace std;
+
+struct SimulationContext;
+
+// Layout of a topology file, all fields are little endian:
+// TopologyFileHeader, uint32 malicious peer ids[num_malicious], TopologyEdge honest[num_honest_edges], TopologyEdge overlay[num_overlay_edges]
+constexpr char topologyMagic[8] = {'S', 'M', 'T', 'O', 'P', 'O', '0', '1'};
+
+struct TopologyFileHeader {
+    char magic[8];
+    uint32_t num_nodes;
+    uint32_t num_malicious;
+    uint32_t num_honest_edges;
+    uint32_t num_overlay_edges;
+};
+
+struct TopologyEdge {
+    uint32_t u;
+    uint32_t v;
+    float bandwidth;        // in bits per second
+    float propagationDelay; // in milliseconds
+};
+
+struct LinkParams {
+    float bandwidth;
+    float propagationDelay;
+};
+
+// Links of one network in compressed sparse row form, the row of every peer is sorted by neighbour id
+struct LinkTable {
+    vector<int> offsets;
+    vector<int> targets;
+    vector<LinkParams> params;
+    bool empty() const { return offsets.empty(); }
+    void build(int num_vertices, const TopologyEdge* edges, uint32_t count);
+    const LinkParams* find(int u, int v) const;
+    long long bytes() const;
+};
+
+void loadTopology(SimulationContext& ctx, const string& path);
+void applyTopology(SimulationContext& ctx);
+double linkLatency(RandomStream& gen, const LinkParams& link, int messageLength);
+
+#endif
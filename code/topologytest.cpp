@@ -0,0 +1,75 @@
+// Checks that loadTopology rejects malformed topology files, build with make topologytest and run ./topologytest
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "context.h"
+#include "topology.h"
+using namespace std;
+
+constexpr float NaN = numeric_limits<float>::quiet_NaN();
+
+// Four peers, 2 and 3 malicious, with a honest ring and one overlay link between the malicious peers
+struct TopologyFile {
+    uint32_t num_nodes = 4;
+    vector<uint32_t> malicious = {2, 3};
+    vector<TopologyEdge> honest = {{0, 1, 5e6, 20}, {1, 2, 5e6, 20}, {2, 3, 100e6, 5}, {3, 0, 100e6, 5}};
+    vector<TopologyEdge> overlay = {{2, 3, 100e6, 1}};
+
+    void write(const string& path) const {
+        TopologyFileHeader header;
+        memcpy(header.magic, topologyMagic, sizeof(topologyMagic));
+        header.num_nodes = num_nodes;
+        header.num_malicious = malicious.size();
+        header.num_honest_edges = honest.size();
+        header.num_overlay_edges = overlay.size();
+        ofstream out(path, ios::binary);
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)malicious.data(), malicious.size() * sizeof(uint32_t));
+        out.write((const char*)honest.data(), honest.size() * sizeof(TopologyEdge));
+        out.write((const char*)overlay.data(), overlay.size() * sizeof(TopologyEdge));
+    }
+};
+
+int main() {
+    string path = "topologytest.bin";
+    int failures = 0;
+    auto check = [&](const string& name, bool whether_valid, function<void(TopologyFile&)> change) {
+        TopologyFile file;
+        change(file);
+        file.write(path);
+        SimulationContext ctx;
+        bool loaded = true;
+        try {
+            loadTopology(ctx, path);
+        } catch (const runtime_error&) {
+            loaded = false;
+        }
+        bool passed = loaded == whether_valid;
+        if (!passed) failures++;
+        cout << (passed ? "ok     " : "FAILED ") << name << (whether_valid ? " is loaded" : " is rejected") << endl;
+    };
+
+    check("valid topology", true, [](TopologyFile&) {});
+    check("malicious peer out of range", false, [](TopologyFile& file) { file.malicious[1] = 4; });
+    check("edge out of range", false, [](TopologyFile& file) { file.honest[0].v = 4; });
+    check("self edge", false, [](TopologyFile& file) { file.honest[0].v = 0; });
+    check("zero bandwidth", false, [](TopologyFile& file) { file.honest[1].bandwidth = 0; });
+    check("negative bandwidth", false, [](TopologyFile& file) { file.honest[1].bandwidth = -5e6; });
+    check("NaN bandwidth", false, [](TopologyFile& file) { file.honest[1].bandwidth = NaN; });
+    check("infinite bandwidth", false, [](TopologyFile& file) { file.overlay[0].bandwidth = INFINITY; });
+    check("zero delay", false, [](TopologyFile& file) { file.honest[2].propagationDelay = 0; });
+    check("negative delay", false, [](TopologyFile& file) { file.honest[2].propagationDelay = -500; });
+    check("NaN delay", false, [](TopologyFile& file) { file.overlay[0].propagationDelay = NaN; });
+    check("infinite delay", false, [](TopologyFile& file) { file.honest[2].propagationDelay = INFINITY; });
+    check("overlay edge with a honest end", false, [](TopologyFile& file) { file.overlay[0].u = 1; });
+    check("overlay edge between honest peers", false, [](TopologyFile& file) { file.overlay[0] = {0, 1, 100e6, 1}; });
+    remove(path.c_str());
+    if (failures) cout << failures << " topology checks failed" << endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+#include "traffic.h"
+#include <iostream>
+
+string linkClassToString(LinkClass link) {
+    switch (link) {
+        case OVERLAY_LINK: return "overlay";
+        case FAST_LINK: return "fast";
+        case SLOW_LINK: return "slow";
+        default: return "unknown";
+    }
+}
+
+void TrafficCounters::merge(const TrafficCounters& other) {
+    for (size_t i = 0; i < messages.size(); i++) {
+        messages[i] += other.messages[i];
+        bytes[i] += other.bytes[i];
+    }
+}
+
+long long TrafficCounters::linkBytes(LinkClass link) const {
+    long long total = 0;
+    for (int type = 0; type < EVENT_TYPE_COUNT; type++) total += bytes[type * LINK_CLASS_COUNT + link];
+    return total;
+}
+
+void printTraffic(const TrafficCounters& traffic) {
+    // Totals per link class, then every message type that was sent, in kilobytes
+    for (int link = 0; link < LINK_CLASS_COUNT; link++) {
+        cout << "Traffic " << linkClassToString((LinkClass)link) << " (KB): " << traffic.linkBytes((LinkClass)link) / 1024 << endl;
+    }
+    for (int type = 0; type < EVENT_TYPE_COUNT; type++) {
+        for (int link = 0; link < LINK_CLASS_COUNT; link++) {
+            int index = type * LINK_CLASS_COUNT + link;
+            if (traffic.messages[index] == 0) continue;
+            cout << "Traffic " << eventTypeName((EventType)type) << " " << linkClassToString((LinkClass)link) << ": "
+                 << traffic.messages[index] << " messages, " << traffic.bytes[index] / 1024 << " KB" << endl;
+        }
+    }
+}
+
+void writeTrafficSample(ofstream& out, double time, const TrafficCounters& traffic) {
+    // One line per message type and link class that was used so far, the counts are cumulative
+    for (int type = 0; type < EVENT_TYPE_COUNT; type++) {
+        for (int link = 0; link < LINK_CLASS_COUNT; link++) {
+            int index = type * LINK_CLASS_COUNT + link;
+            if (traffic.messages[index] == 0) continue;
+            out << time << "," << eventTypeName((EventType)type) << "," << linkClassToString((LinkClass)link) << ","
+                << traffic.messages[index] << "," << traffic.bytes[index] << "\n";
+        }
+    }
+}
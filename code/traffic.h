@@ -0,0 +1,39 @@
+/* This file contains the accounting of the messages sent per event type and link class */
+#ifndef TRAFFIC_H
+#define TRAFFIC_H
+
+#include <array>
+#include <fstream>
+#include <string>
+#include "event.h"
+using namespace std;
+
+// Links a message can take: the overlay of the malicious peers, or an honest network link between two fast
+// peers or with at least one slow end (with a topology file, by the bandwidth of the link)
+enum LinkClass {
+    OVERLAY_LINK,
+    FAST_LINK,
+    SLOW_LINK,
+    LINK_CLASS_COUNT,
+};
+
+string linkClassToString(LinkClass link);
+
+// Messages and bytes sent, as flat arrays with one entry per event type and link class. Every partition counts
+// the messages of its own peers, so the counters are added up when they are reported.
+struct TrafficCounters {
+    array<long long, (int)EVENT_TYPE_COUNT * (int)LINK_CLASS_COUNT> messages{};
+    array<long long, (int)EVENT_TYPE_COUNT * (int)LINK_CLASS_COUNT> bytes{};
+    void add(EventType type, LinkClass link, int messageLength) {
+        int index = (int)type * (int)LINK_CLASS_COUNT + (int)link;
+        messages[index]++;
+        bytes[index] += messageLength / 8; // Message lengths are in bits
+    }
+    void merge(const TrafficCounters& other);
+    long long linkBytes(LinkClass link) const;
+};
+
+void printTraffic(const TrafficCounters& traffic);
+void writeTrafficSample(ofstream& out, double time, const TrafficCounters& traffic);
+
+#endif
@@ -1,11 +1,9 @@
 #include "transaction.h"
-#include "helper.h"
 #include <sstream>
 
-Transaction::Transaction(int sender, int receiver, double amount)
-    : sender(sender), receiver(receiver), amount(amount) {
-        // Constructor
-    id = generateTransactionID();
+Transaction::Transaction(int id, int sender, int receiver, double amount)
+    : id(id), sender(sender), receiver(receiver), amount(amount) {
+        // Constructor, the id comes from SimulationContext::generateTransactionID
 }
 
 int Transaction::getID() const {
@@ -30,3 +28,29 @@ string Transaction::getString()
     res += " coins";
     return res;
 }
+
+TxIndex TransactionTable::append(const Transaction& txn) {
+    // The peers of all the partitions append, every column gets the same index
+    lock_guard<mutex> guard(appendLock);
+    int id = txn.getID();
+    senders.append(&txn.sender, 1);
+    receivers.append(&txn.receiver, 1);
+    amounts.append(&txn.amount, 1);
+    return ids.append(&id, 1);
+}
+
+TransactionSpan TransactionTable::appendBlock(const vector<TxIndex>& transactions) {
+    lock_guard<mutex> guard(appendLock);
+    TransactionSpan span;
+    span.count = transactions.size();
+    span.begin = blockTransactions.append(transactions.data(), span.count);
+    return span;
+}
+
+long long TransactionTable::memoryBytes() const {
+    // The chunks are only backed by memory as far as they were written
+    long long bytes = sizeof(TransactionTable) + 5 * ChunkedArray<int>::maxChunks * sizeof(void*);
+    bytes += (long long)size() * (3 * sizeof(int) + sizeof(double));
+    bytes += (long long)blockTransactionCount() * sizeof(TxIndex);
+    return bytes;
+}
@@ -1,16 +1,23 @@
-// Contains the transaction class
+// Contains the transaction class and the transaction table of a simulation
 #ifndef TRANSACTION_H
 #define TRANSACTION_H
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <vector>
 using namespace std;
 
-extern const int TransactionSize; // referring from main.cpp
+extern const int TransactionSize; // referring from constants.cpp
 
 class Transaction {
+    int id;
 public:
     Transaction() = default;
-    Transaction(int sender, int receiver, double amount);
+    Transaction(int id, int sender, int receiver, double amount);
     int getID() const;
     int getSize();
     string getString();
@@ -21,9 +28,79 @@ public:
         // For storing the transactions in a set, we have defined the order of transactions
         return id > other.id;
     }
+};
+
+typedef uint32_t TxIndex; // Position of a transaction in the TransactionTable of the simulation
+
+// The transactions of a block, a range of TransactionTable::blockTransactions
+struct TransactionSpan {
+    uint32_t begin = 0;
+    uint32_t count = 0;
+};
+
+// Append only array whose elements never move, so the peers of one partition can read the entries they were
+// told about while the peers of another partition append new ones. A range appended in one go is contiguous.
+template <typename T> class ChunkedArray {
+public:
+    static constexpr int chunkBits = 18;
+    static constexpr uint32_t chunkSize = 1u << chunkBits;
+    static constexpr uint32_t maxChunks = 1u << (32 - chunkBits);
+    ChunkedArray() : chunks(new atomic<T*>[maxChunks]()) {}
+    ~ChunkedArray() {
+        for (uint32_t c = 0; c < maxChunks; c++) delete[] chunks[c].load(memory_order_relaxed);
+    }
+    ChunkedArray(const ChunkedArray&) = delete;
+    ChunkedArray& operator=(const ChunkedArray&) = delete;
+    const T& operator[](uint32_t i) const { return chunks[i >> chunkBits].load(memory_order_acquire)[i & (chunkSize - 1)]; }
+    uint32_t size() const { return length; }
+    // The callers serialise the appends
+    uint32_t append(const T* values, uint32_t n) {
+        if ((length & (chunkSize - 1)) + n > chunkSize) {
+            // Pad the rest of the chunk, so the range stays in one chunk
+            T empty{};
+            while (length & (chunkSize - 1)) append(&empty, 1);
+        }
+        uint32_t begin = length;
+        for (uint32_t i = 0; i < n; i++, length++) {
+            uint32_t chunk = length >> chunkBits;
+            if (!chunks[chunk].load(memory_order_relaxed)) chunks[chunk].store(new T[chunkSize], memory_order_release);
+            chunks[chunk].load(memory_order_relaxed)[length & (chunkSize - 1)] = values[i];
+        }
+        return begin;
+    }
+    span<const T> range(uint32_t begin, uint32_t n) const {
+        if (n == 0) return {};
+        return span<const T>(&(*this)[begin], n);
+    }
+private:
+    unique_ptr<atomic<T*>[]> chunks;
+    uint32_t length = 0;
+};
 
+// Every transaction of a simulation, stored once as columns and referred to by its TxIndex from the events,
+// the mempools and the blocks. Blocks keep a span of blockTransactions, so all the copies of a block share
+// its list of transactions.
+class TransactionTable {
+public:
+    TxIndex append(const Transaction& txn);
+    TransactionSpan appendBlock(const vector<TxIndex>& transactions);
+    int id(TxIndex txn) const { return ids[txn]; }
+    int sender(TxIndex txn) const { return senders[txn]; }
+    int receiver(TxIndex txn) const { return receivers[txn]; }
+    double amount(TxIndex txn) const { return amounts[txn]; }
+    Transaction get(TxIndex txn) const { return Transaction(ids[txn], senders[txn], receivers[txn], amounts[txn]); }
+    span<const TxIndex> block(TransactionSpan transactions) const { return blockTransactions.range(transactions.begin, transactions.count); }
+    uint32_t size() const { return ids.size(); }
+    uint32_t blockTransactionCount() const { return blockTransactions.size(); }
+    TxIndex blockTransaction(uint32_t i) const { return blockTransactions[i]; }
+    long long memoryBytes() const;
 private:
-    int id;
+    mutex appendLock;
+    ChunkedArray<int> ids;
+    ChunkedArray<int> senders;
+    ChunkedArray<int> receivers;
+    ChunkedArray<double> amounts;
+    ChunkedArray<TxIndex> blockTransactions;
 };
 
-#endif
\ No newline at end of file
+#endif
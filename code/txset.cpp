@@ -0,0 +1,60 @@
+#include "txset.h"
+
+bool TransactionSet::insert(TxIndex txn) {
+    uint32_t chunk = txn >> chunkBits;
+    if (chunk >= counts.size()) {
+        counts.resize(chunk + 1);
+        chunks.resize(chunk + 1);
+    }
+    if (counts[chunk] == chunkSize) return false;
+    if (!chunks[chunk]) chunks[chunk] = make_unique<uint64_t[]>(chunkWords);
+    uint64_t& word = chunks[chunk][(txn & (chunkSize - 1)) >> 6];
+    uint64_t bit = 1ull << (txn & 63);
+    if (word & bit) return false;
+    word |= bit;
+    count++;
+    if (++counts[chunk] == chunkSize) chunks[chunk].reset(); // Every transaction of the chunk is in the set
+    return true;
+}
+
+bool TransactionSet::erase(TxIndex txn) {
+    if (!contains(txn)) return false;
+    uint32_t chunk = txn >> chunkBits;
+    if (counts[chunk] == chunkSize) {
+        // Expand the full chunk again
+        chunks[chunk] = make_unique<uint64_t[]>(chunkWords);
+        for (uint32_t word = 0; word < chunkWords; word++) chunks[chunk][word] = ~0ull;
+    }
+    chunks[chunk][(txn & (chunkSize - 1)) >> 6] &= ~(1ull << (txn & 63));
+    count--;
+    if (--counts[chunk] == 0) chunks[chunk].reset();
+    return true;
+}
+
+long long TransactionSet::memoryBytes() const {
+    long long bytes = sizeof(TransactionSet) + chunks.capacity() * sizeof(chunks[0]) + counts.capacity() * sizeof(uint16_t);
+    for (auto& bits : chunks) if (bits) bytes += chunkWords * sizeof(uint64_t);
+    return bytes;
+}
+
+void TransactionSet::saveState(CheckpointWriter& out) const {
+    // The counts tell which chunks are empty or full, only the bits of the other chunks follow
+    out.write(counts);
+    for (uint32_t chunk = 0; chunk < counts.size(); chunk++) {
+        if (counts[chunk] == 0 || counts[chunk] == chunkSize) continue;
+        for (uint32_t word = 0; word < chunkWords; word++) out.write(chunks[chunk][word]);
+    }
+}
+
+void TransactionSet::loadState(CheckpointReader& in) {
+    in.read(counts);
+    chunks.clear();
+    chunks.resize(counts.size());
+    count = 0;
+    for (uint32_t chunk = 0; chunk < counts.size(); chunk++) {
+        count += counts[chunk];
+        if (counts[chunk] == 0 || counts[chunk] == chunkSize) continue;
+        chunks[chunk] = make_unique<uint64_t[]>(chunkWords);
+        for (uint32_t word = 0; word < chunkWords; word++) in.read(chunks[chunk][word]);
+    }
+}
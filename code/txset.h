@@ -0,0 +1,55 @@
+/* This file contains the compressed bitset used by the peers for sets of transaction indices */
+#ifndef TXSET_H
+#define TXSET_H
+
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "transaction.h"
+#include "checkpoint.h"
+using namespace std;
+
+// Set of indices of the TransactionTable. The index space is cut into chunks of 4096 bits which are only
+// allocated once one of their transactions is added. Most transactions end up known to every peer, so a chunk
+// whose bits are all set is freed again and only remembered as full: the memory of a peer follows the
+// transactions still in flight instead of all the transactions of the run.
+class TransactionSet {
+public:
+    bool contains(TxIndex txn) const {
+        uint32_t chunk = txn >> chunkBits;
+        if (chunk >= counts.size() || counts[chunk] == 0) return false;
+        if (counts[chunk] == chunkSize) return true;
+        return (chunks[chunk][(txn & (chunkSize - 1)) >> 6] >> (txn & 63)) & 1;
+    }
+    bool insert(TxIndex txn); // Returns false when the index was already in the set
+    bool erase(TxIndex txn);  // Returns false when the index was not in the set
+    size_t size() const { return count; }
+    template <typename Function> void forEach(Function function) const {
+        // Visit the indices in increasing order
+        for (uint32_t chunk = 0; chunk < counts.size(); chunk++) {
+            if (counts[chunk] == 0) continue;
+            TxIndex base = chunk << chunkBits;
+            if (counts[chunk] == chunkSize) {
+                for (uint32_t bit = 0; bit < chunkSize; bit++) function(base + bit);
+                continue;
+            }
+            for (uint32_t word = 0; word < chunkWords; word++) {
+                for (uint64_t bits = chunks[chunk][word]; bits; bits &= bits - 1) function(base + word * 64 + countr_zero(bits));
+            }
+        }
+    }
+    long long memoryBytes() const;
+    void saveState(CheckpointWriter& out) const;
+    void loadState(CheckpointReader& in);
+
+private:
+    static constexpr int chunkBits = 12;
+    static constexpr uint32_t chunkSize = 1u << chunkBits;
+    static constexpr uint32_t chunkWords = chunkSize / 64;
+    vector<unique_ptr<uint64_t[]>> chunks; // Bits of the partly filled chunks, empty and full chunks own no memory
+    vector<uint16_t> counts;               // Number of indices in every chunk, chunkSize for a full chunk
+    size_t count = 0;
+};
+
+#endif